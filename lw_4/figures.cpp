@@ -4,21 +4,169 @@
 #include <algorithm>
 #include <vector>
 #include <stdexcept>
+#include <cstdint>
+#include <thread>
+#include <set>
+#include <memory>
+#include <queue>
+#include <numeric>
+#include <fstream>
+#include <cstring>
+#include <unordered_map>
+#include <numeric>
+#include <mutex>
+#include <span>
+#include <array>
+#include <queue>
+#include <charconv>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <compare>
 
 #define EPS 1e-6
 #define RUDE_EPS 0.1
 
 using namespace std;
 
+// Signed fixed-point number with FRACTION fractional bits.
+template<int FRACTION>
+struct Fixed {
+    static_assert(FRACTION > 0 and FRACTION < 62);
+    int64_t raw = 0;
+
+    Fixed() = default;
+
+    Fixed(double value): raw(llround(value * (int64_t(1) << FRACTION))) {}
+
+    static Fixed from_raw(int64_t value) {
+        Fixed result;
+        result.raw = value;
+        return result;
+    }
+
+    explicit operator double() const {
+        return static_cast<double>(raw) / (int64_t(1) << FRACTION);
+    }
+
+    Fixed& operator +=(const Fixed& other) {
+        raw += other.raw;
+        return *this;
+    }
+
+    Fixed& operator -=(const Fixed& other) {
+        raw -= other.raw;
+        return *this;
+    }
+
+    Fixed& operator *=(const Fixed& other) {
+        raw = static_cast<int64_t>((static_cast<__int128>(raw) * other.raw) >> FRACTION);
+        return *this;
+    }
+
+    Fixed& operator /=(const Fixed& other) {
+        if (other.raw == 0)
+            throw invalid_argument("ZERO_DIVISION");
+        raw = static_cast<int64_t>((static_cast<__int128>(raw) << FRACTION) / other.raw);
+        return *this;
+    }
+
+    friend Fixed operator +(Fixed a, const Fixed& b) { return a += b; }
+    friend Fixed operator -(Fixed a, const Fixed& b) { return a -= b; }
+    friend Fixed operator *(Fixed a, const Fixed& b) { return a *= b; }
+    friend Fixed operator /(Fixed a, const Fixed& b) { return a /= b; }
+    friend Fixed operator -(const Fixed& a) { return from_raw(-a.raw); }
+
+    friend bool operator ==(const Fixed& a, const Fixed& b) = default;
+    friend auto operator <=>(const Fixed& a, const Fixed& b) = default;
+
+    // Tolerances such as EPS are finer than the representation, so mixed comparisons go through double.
+    friend bool operator ==(const Fixed& a, double b) { return static_cast<double>(a) == b; }
+    friend partial_ordering operator <=>(const Fixed& a, double b) { return static_cast<double>(a) <=> b; }
+
+    friend Fixed fabs(const Fixed& a) { return from_raw(a.raw < 0 ? -a.raw : a.raw); }
+    friend Fixed sqrt(const Fixed& a) { return Fixed(sqrt(static_cast<double>(a))); }
+
+    friend ostream& operator <<(ostream& os, const Fixed& a) {
+        return os << static_cast<double>(a);
+    }
+
+    friend istream& operator >>(istream& is, Fixed& a) {
+        double value;
+        if (is >> value)
+            a = Fixed(value);
+        return is;
+    }
+};
+
 template <typename T>
 concept Number = requires(T a, T b) {
     {a + b} -> same_as<T>;
     {a - b} -> same_as<T>;
     {a / b} -> same_as<T>;
-    {fabs(a)} -> same_as<T>;
-    {sqrt(a)} -> same_as<T>;
     {a == b} -> convertible_to<bool>;
     {a != b} -> convertible_to<bool>;
+} and (integral<T> or requires(T a) {
+    {fabs(a)} -> same_as<T>;
+    {sqrt(a)} -> same_as<T>;
+});
+
+// Exact arithmetic for integer and fixed-point coordinates: products and sums of products
+// are formed in 128 bits, so areas, orientations and lengths are compared without EPS.
+// For 64-bit values the coordinates must stay within +-2^62.
+template<typename T>
+struct Exact {
+    static constexpr bool exact = false;
+    using wide = double;
+
+    static wide widen(const T& value) {
+        return static_cast<double>(value);
+    }
+
+    static T from_product(wide value) {
+        return static_cast<T>(value);
+    }
+
+    static T from_double(double value) {
+        return static_cast<T>(value);
+    }
+};
+
+template<integral T>
+struct Exact<T> {
+    static constexpr bool exact = true;
+    using wide = __int128;
+
+    static wide widen(const T& value) {
+        return value;
+    }
+
+    static T from_product(wide value) {
+        return static_cast<T>(value);
+    }
+
+    static T from_double(double value) {
+        return static_cast<T>(llround(value));
+    }
+};
+
+template<int FRACTION>
+struct Exact<Fixed<FRACTION>> {
+    static constexpr bool exact = true;
+    using wide = __int128;
+
+    static wide widen(const Fixed<FRACTION>& value) {
+        return value.raw;
+    }
+
+    static Fixed<FRACTION> from_product(wide value) {
+        return Fixed<FRACTION>::from_raw(static_cast<int64_t>(value >> FRACTION));
+    }
+
+    static Fixed<FRACTION> from_double(double value) {
+        return Fixed<FRACTION>(value);
+    }
 };
 
 template <Number T>
@@ -33,7 +181,7 @@ struct Point {
         return *this;
     }
 
-    Point operator -(const Point& other) {
+    Point operator -(const Point& other) const {
         Point result(x - other.x, y - other.y);
         return result;
     }
@@ -60,8 +208,11 @@ struct Point {
         return true;
     }
 
+    // Computed in double and rounded once, so integer lengths are not truncated.
     T distance(const Point& other) const {
-        return sqrt((x - other.x) * (x - other.x) + (y - other.y) * (y - other.y));
+        double dx = static_cast<double>(x) - static_cast<double>(other.x);
+        double dy = static_cast<double>(y) - static_cast<double>(other.y);
+        return Exact<T>::from_double(sqrt(dx * dx + dy * dy));
     }
 
     friend ostream& operator <<(ostream& os, const Point& p) {
@@ -72,22 +223,225 @@ struct Point {
         return is >> p.x >> p.y;
     }
 };
+// Error-free transformations: s + e == a + b and p + e == a * b exactly.
+inline void two_sum(double a, double b, double& s, double& e) {
+    s = a + b;
+    double b_part = s - a;
+    e = (a - (s - b_part)) + (b - b_part);
+}
+
+inline void two_product(double a, double b, double& p, double& e) {
+    p = a * b;
+    e = fma(a, b, -p);
+}
+
+// Sign of the exact sum of the terms, accumulated as a non-overlapping expansion.
+template<size_t N>
+int exact_sign(const double (&terms)[N]) {
+    double expansion[N];
+    size_t length = 0;
+    for (double term: terms) {
+        double q = term;
+        for (size_t i = 0; i < length; ++i)
+            two_sum(q, expansion[i], q, expansion[i]);
+        expansion[length++] = q;
+    }
+    for (size_t i = length; i-- > 0;)
+        if (expansion[i] != 0.0)
+            return expansion[i] > 0.0 ? 1 : -1;
+    return 0;
+}
+
+// Doubled signed area of the triangle oab.
+template<typename T>
+double cross(const Point<T>& o, const Point<T>& a, const Point<T>& b) {
+    double ox = static_cast<double>(o.x), oy = static_cast<double>(o.y);
+    return (static_cast<double>(a.x) - ox) * (static_cast<double>(b.y) - oy)
+        - (static_cast<double>(a.y) - oy) * (static_cast<double>(b.x) - ox);
+}
+
+// Doubled signed area of the triangle oab in the wide type of T.
+template<typename T>
+typename Exact<T>::wide exact_cross(const Point<T>& o, const Point<T>& a, const Point<T>& b) {
+    using E = Exact<T>;
+    return (E::widen(a.x) - E::widen(o.x)) * (E::widen(b.y) - E::widen(o.y))
+        - (E::widen(a.y) - E::widen(o.y)) * (E::widen(b.x) - E::widen(o.x));
+}
+
+template<typename T>
+typename Exact<T>::wide exact_sqr_distance(const Point<T>& a, const Point<T>& b) {
+    using E = Exact<T>;
+    return (E::widen(a.x) - E::widen(b.x)) * (E::widen(a.x) - E::widen(b.x))
+        + (E::widen(a.y) - E::widen(b.y)) * (E::widen(a.y) - E::widen(b.y));
+}
+
+// 1 if c lies to the left of the directed line ab, -1 if to the right, 0 if collinear.
+// The double determinant is trusted when it clears the rounding error bound, otherwise the
+// sign is recomputed exactly.
+template<typename T>
+int orient(const Point<T>& a, const Point<T>& b, const Point<T>& c) {
+    if constexpr (Exact<T>::exact) {
+        auto det = exact_cross(a, b, c);
+        return (det > 0) - (det < 0);
+    }
+    double ax = static_cast<double>(a.x), ay = static_cast<double>(a.y);
+    double bx = static_cast<double>(b.x), by = static_cast<double>(b.y);
+    double cx = static_cast<double>(c.x), cy = static_cast<double>(c.y);
+    double left = (bx - ax) * (cy - ay), right = (by - ay) * (cx - ax);
+    double det = left - right, bound = 3.3306690738754716e-16 * (fabs(left) + fabs(right));
+    if (det > bound)
+        return 1;
+    if (-det > bound)
+        return -1;
+    double terms[12];
+    two_product(bx, cy, terms[0], terms[1]);
+    two_product(-bx, ay, terms[2], terms[3]);
+    two_product(-ax, cy, terms[4], terms[5]);
+    two_product(-by, cx, terms[6], terms[7]);
+    two_product(by, ax, terms[8], terms[9]);
+    two_product(ay, cx, terms[10], terms[11]);
+    return exact_sign(terms);
+}
+
+// Directions (ux, uy) and (vx, vy) differ by less than EPS in the sine of their angle.
+inline bool parallel_directions(double ux, double uy, double vx, double vy) {
+    double c = ux * vy - uy * vx;
+    return c * c <= EPS * EPS * (ux * ux + uy * uy) * (vx * vx + vy * vy);
+}
+
+// Lengths whose squares are s1 and s2 differ by at most EPS. Uses |s1 - s2| = |d1 - d2| * (d1 + d2)
+// with (d1 + d2)^2 bounded from below by s1 + s2 + 2 * min(s1, s2), so no square root is taken.
+inline bool equal_lengths(double s1, double s2) {
+    double d = s1 - s2;
+    return d * d <= EPS * EPS * (s1 + s2 + 2 * min(s1, s2));
+}
+
+template<typename T>
+double sqr_distance(const Point<T>& a, const Point<T>& b) {
+    double dx = static_cast<double>(a.x) - static_cast<double>(b.x);
+    double dy = static_cast<double>(a.y) - static_cast<double>(b.y);
+    return dx * dx + dy * dy;
+}
+
+// Squared distance from p to the segment ab.
+template<typename T>
+double sqr_segment_distance(const Point<T>& p, const Point<T>& a, const Point<T>& b) {
+    double ax = static_cast<double>(a.x), ay = static_cast<double>(a.y);
+    double dx = static_cast<double>(b.x) - ax, dy = static_cast<double>(b.y) - ay;
+    double px = static_cast<double>(p.x) - ax, py = static_cast<double>(p.y) - ay;
+    double length = dx * dx + dy * dy;
+    double t = length > 0 ? clamp((px * dx + py * dy) / length, 0.0, 1.0) : 0.0;
+    return (px - t * dx) * (px - t * dx) + (py - t * dy) * (py - t * dy);
+}
+
 template <typename T>
 bool parallel(const Point<T>& p1, const Point<T>& p2, const Point<T>& p3, const Point<T>& p4) {
-    if (fabs(p1.x - p2.x) < EPS && fabs(p3.x - p4.x) < EPS)
+    if constexpr (Exact<T>::exact)
+        return exact_cross(Point<T>(), p2 - p1, p4 - p3) == 0;
+    return parallel_directions(static_cast<double>(p2.x) - static_cast<double>(p1.x), static_cast<double>(p2.y) - static_cast<double>(p1.y),
+        static_cast<double>(p4.x) - static_cast<double>(p3.x), static_cast<double>(p4.y) - static_cast<double>(p3.y));
+}
+
+template<typename T>
+bool same_length(const Point<T>& p1, const Point<T>& p2, const Point<T>& p3, const Point<T>& p4) {
+    if constexpr (Exact<T>::exact)
+        return exact_sqr_distance(p1, p2) == exact_sqr_distance(p3, p4);
+    return equal_lengths(sqr_distance(p1, p2), sqr_distance(p3, p4));
+}
+
+template<typename T>
+bool on_segment(const Point<T>& p, const Point<T>& a, const Point<T>& b) {
+    return min(a.x, b.x) <= p.x and p.x <= max(a.x, b.x) and min(a.y, b.y) <= p.y and p.y <= max(a.y, b.y);
+}
+
+template<typename T>
+bool segments_intersect(const Point<T>& p1, const Point<T>& p2, const Point<T>& p3, const Point<T>& p4) {
+    int d1 = orient(p3, p4, p1), d2 = orient(p3, p4, p2);
+    int d3 = orient(p1, p2, p3), d4 = orient(p1, p2, p4);
+    if (d1 * d2 < 0 and d3 * d4 < 0)
         return true;
-    else if (fabs(p1.x - p2.x) < EPS || fabs(p3.x - p4.x) < EPS)
-        return false;
-    return fabs((p2.y - p1.y) / (p2.x - p1.x) - (p4.y - p3.y) / (p4.x - p3.x)) < EPS;
+    return (d1 == 0 and on_segment(p1, p3, p4)) or (d2 == 0 and on_segment(p2, p3, p4))
+        or (d3 == 0 and on_segment(p3, p1, p2)) or (d4 == 0 and on_segment(p4, p1, p2));
 }
 
+// Splits [0, count) into one contiguous range per hardware thread and runs f(begin, end) on each.
+// Range boundaries are multiples of grain, small inputs stay on the calling thread.
+template<typename F>
+void parallel_chunks(size_t count, size_t grain, F f) {
+    size_t workers = min<size_t>(max(1u, thread::hardware_concurrency()), (count + grain - 1) / grain);
+    if (workers <= 1) {
+        if (count > 0)
+            f(size_t(0), count);
+        return;
+    }
+    size_t step = ((count + workers - 1) / workers + grain - 1) / grain * grain;
+    vector<thread> pool;
+    for (size_t begin = 0; begin < count; begin += step)
+        pool.emplace_back(f, begin, min(count, begin + step));
+    for (auto& t: pool)
+        t.join();
+}
+
+// Sorts chunks in parallel and merges neighbouring runs level by level.
+template<typename V, typename Compare>
+void parallel_sort(vector<V>& values, Compare less, size_t grain = 1 << 14) {
+    size_t runs = min<size_t>(max(1u, thread::hardware_concurrency()), (values.size() + grain - 1) / grain);
+    if (runs <= 1) {
+        sort(values.begin(), values.end(), less);
+        return;
+    }
+    size_t step = (values.size() + runs - 1) / runs;
+    parallel_chunks(runs, 1, [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r)
+            sort(values.begin() + min(values.size(), r * step), values.begin() + min(values.size(), (r + 1) * step), less);
+    });
+    for (; step < values.size(); step *= 2) {
+        size_t pairs = (values.size() + 2 * step - 1) / (2 * step);
+        parallel_chunks(pairs, 1, [&](size_t begin, size_t end) {
+            for (size_t r = begin; r < end; ++r) {
+                auto first = values.begin() + r * 2 * step;
+                auto middle = values.begin() + min(values.size(), r * 2 * step + step);
+                auto last = values.begin() + min(values.size(), (r + 1) * 2 * step);
+                inplace_merge(first, middle, last, less);
+            }
+        });
+    }
+}
+
+template<typename T>
+class Locator;
+
+template<typename T>
+class Loader;
+
+template<typename T>
+class FigureFile;
+
+enum class FigureKind : uint8_t { figure, square, rectangle, trapezoid };
+
 template<typename T>
 class Figure {
 protected:
     int n = -1;
-    Point<T>* vertices;
+    Point<T>* vertices = nullptr;
+
+    template<typename> friend class Locator;
+    template<typename> friend class Loader;
+    template<typename> friend class FigureFile;
+
+    Figure simplified(const vector<Point<T>>& kept) const {
+        if (kept.size() >= 3)
+            return Figure(kept);
+        vector<Point<T>> result(kept);
+        for (int i = 0; static_cast<int>(result.size()) < min(3, n) and i < n; ++i)
+            if (find_if(result.begin(), result.end(), [&](const Point<T>& p) { return p.x == vertices[i].x and p.y == vertices[i].y; }) == result.end())
+                result.push_back(vertices[i]);
+        return Figure(result);
+    }
 
     virtual bool check() const {
+        if constexpr (Exact<T>::exact)
+            return doubled_area() > 0;
         return !(area() <= 0.0);
     }
 
@@ -96,6 +450,11 @@ public:
     
     Figure(int _n): n(_n) {vertices = new Point<T>[_n];}
 
+    explicit Figure(const vector<Point<T>>& points): n(points.size()) {
+        vertices = new Point<T>[n];
+        copy(points.begin(), points.end(), vertices);
+    }
+
     Figure(const Figure& other): n(other.n) {
         vertices = new Point<T>[n];
         for (size_t i = 0; i < n; ++i)
@@ -135,13 +494,15 @@ public:
 
     Point<T> center() const {
         Point<T> result;
-        for (size_t i = 0; i < n; ++i)
+        for (int i = 0; i < n; ++i)
             result += vertices[i];
         result /= n;
         return result;
     }
 
     virtual void add_point(const Point<T> p) {
+        if (n < 0)
+            n = 0;
         Point<T>* result = new Point<T>[n + 1];
         for (size_t i = 0; i < n; ++i)
             result[i] = vertices[i];
@@ -150,14 +511,25 @@ public:
         vertices = result;
     }
 
+    // Summed in double and rounded once.
     virtual T perimeter() const {
-        T result = vertices[n - 1].distance(vertices[0]);
+        double result = sqrt(sqr_distance(vertices[n - 1], vertices[0]));
         for (size_t i = 0; i < n - 1; ++i)
-            result += vertices[i].distance(vertices[i + 1]);
-        return result;
+            result += sqrt(sqr_distance(vertices[i], vertices[i + 1]));
+        return Exact<T>::from_double(result);
+    }
+
+    // Twice the area by the shoelace formula, exact for integer and fixed-point coordinates.
+    typename Exact<T>::wide doubled_area() const {
+        typename Exact<T>::wide result = 0;
+        for (int i = 0; i < n; ++i)
+            result += exact_cross(Point<T>(), vertices[i], vertices[(i + 1) % n]);
+        return result < 0 ? -result : result;
     }
 
     virtual T area() const {
+        if constexpr (Exact<T>::exact)
+            return Exact<T>::from_product(doubled_area() / 2);
         auto tr_ar = [](const Point<T>& A, const Point<T>& B, const Point<T>& C) -> T {
             return 0.5 * fabs(A.x * (B.y - C.y) + B.x * (C.y - A.y) + C.x * (A.y - B.y));
         };
@@ -218,13 +590,186 @@ public:
     virtual operator double() const {
         return static_cast<double>(this -> area());
     }
+
+    virtual FigureKind kind() const {
+        return FigureKind::figure;
+    }
+
+    // Edge lengths and turn angles walking the outline counterclockwise: first[i] is the length
+    // of the i-th edge, second[i] the signed turn in radians at its end.
+    pair<vector<double>, vector<double>> outline() const {
+        vector<int> order(n);
+        iota(order.begin(), order.end(), 0);
+        double winding = 0.0;
+        for (int i = 0; i < n; ++i)
+            winding += cross(Point<T>(), vertices[i], vertices[(i + 1) % n]);
+        if (winding < 0)
+            reverse(order.begin(), order.end());
+        vector<double> lengths(n), turns(n);
+        for (int i = 0; i < n; ++i) {
+            const Point<T>& a = vertices[order[i]];
+            const Point<T>& b = vertices[order[(i + 1) % n]];
+            const Point<T>& c = vertices[order[(i + 2) % n]];
+            double ux = static_cast<double>(b.x) - static_cast<double>(a.x), uy = static_cast<double>(b.y) - static_cast<double>(a.y);
+            double vx = static_cast<double>(c.x) - static_cast<double>(b.x), vy = static_cast<double>(c.y) - static_cast<double>(b.y);
+            lengths[i] = sqrt(ux * ux + uy * uy);
+            turns[i] = atan2(ux * vy - uy * vx, ux * vx + uy * vy);
+        }
+        return {lengths, turns};
+    }
+
+    // Outlines that agree within eps once one of them is started at another vertex, or walked
+    // in the opposite direction, which is the outline of the mirror image.
+    static bool same_outline(const pair<vector<double>, vector<double>>& a, const pair<vector<double>, vector<double>>& b, double eps) {
+        const auto& [la, ta] = a;
+        const auto& [lb, tb] = b;
+        size_t n = la.size();
+        if (lb.size() != n)
+            return false;
+        for (size_t k = 0; k < n; ++k) {
+            bool forward = true, mirrored = true;
+            for (size_t j = 0; (forward or mirrored) and j < n; ++j) {
+                size_t f = (j + k) % n, m = (k + n - j) % n, mt = (k + 2 * n - j - 1) % n;
+                forward = forward and fabs(la[j] - lb[f]) < eps and fabs(ta[j] - tb[f]) < eps;
+                mirrored = mirrored and fabs(la[j] - lb[m]) < eps and fabs(ta[j] - tb[mt]) < eps;
+            }
+            if (forward or mirrored)
+                return true;
+        }
+        return false;
+    }
+
+    // Same kind and an outline that matches up to rotation, translation and reflection.
+    bool congruent(const Figure& other) const {
+        return kind() == other.kind() and same_outline(outline(), other.outline(), signature_eps());
+    }
+
+    // Values that do not change under rotation, translation and reflection: the area followed by
+    // the edge lengths in decreasing order. The lengths of congruent figures agree within
+    // signature_eps(), so signatures only narrow down the candidates for same_outline().
+    virtual vector<double> signature() const {
+        vector<double> result(n + 1);
+        result[0] = static_cast<double>(doubled_area()) / 2;
+        for (int i = 0; i < n; ++i)
+            result[i + 1] = sqrt(sqr_distance(vertices[i], vertices[(i + 1) % n]));
+        sort(result.begin() + 1, result.end(), greater<double>());
+        return result;
+    }
+
+    virtual double signature_eps() const {
+        return EPS;
+    }
+
+    // Bit i of word i / 64 is set when points[i] lies inside the figure.
+    vector<uint64_t> contains(const vector<Point<T>>& points) const {
+        return Locator<T>(*this).contains(points);
+    }
+
+    // Douglas-Peucker: every dropped vertex lies within tolerance of the simplified outline.
+    Figure simplify_dp(T tolerance) const {
+        double limit = static_cast<double>(tolerance) * static_cast<double>(tolerance);
+        int far = 0;
+        for (int i = 1; i < n; ++i)
+            if (sqr_distance(vertices[0], vertices[i]) > sqr_distance(vertices[0], vertices[far]))
+                far = i;
+        vector<char> keep(n, 0);
+        keep[0] = keep[far] = 1;
+        vector<pair<int, int>> stack = {{0, far}, {far, n}};
+        while (!stack.empty()) {
+            auto [first, last] = stack.back();
+            stack.pop_back();
+            double worst = 0.0;
+            int split = first;
+            for (int i = first + 1; i < last; ++i) {
+                double d = sqr_segment_distance(vertices[i], vertices[first], vertices[last % n]);
+                if (d > worst) {
+                    worst = d;
+                    split = i;
+                }
+            }
+            if (worst > limit) {
+                keep[split] = 1;
+                stack.push_back({first, split});
+                stack.push_back({split, last});
+            }
+        }
+        vector<Point<T>> result;
+        for (int i = 0; i < n; ++i)
+            if (keep[i])
+                result.push_back(vertices[i]);
+        return simplified(result);
+    }
+
+    // Visvalingam-Whyatt: repeatedly drops the vertex whose triangle with its neighbours has
+    // the smallest area, while that area is below tolerance.
+    Figure simplify_vw(T tolerance) const {
+        vector<int> prev(n), next(n);
+        vector<double> weight(n);
+        for (int i = 0; i < n; ++i) {
+            prev[i] = (i + n - 1) % n;
+            next[i] = (i + 1) % n;
+        }
+        auto triangle = [&](int i) {
+            return 0.5 * fabs(cross(vertices[prev[i]], vertices[i], vertices[next[i]]));
+        };
+        priority_queue<pair<double, int>, vector<pair<double, int>>, greater<>> queue;
+        for (int i = 0; i < n; ++i)
+            queue.push({weight[i] = triangle(i), i});
+        vector<char> removed(n, 0);
+        int left = n;
+        while (left > 3 and !queue.empty()) {
+            auto [area, i] = queue.top();
+            queue.pop();
+            if (removed[i] or area != weight[i])
+                continue;
+            if (area >= static_cast<double>(tolerance))
+                break;
+            removed[i] = 1;
+            --left;
+            next[prev[i]] = next[i];
+            prev[next[i]] = prev[i];
+            queue.push({weight[prev[i]] = triangle(prev[i]), prev[i]});
+            queue.push({weight[next[i]] = triangle(next[i]), next[i]});
+        }
+        vector<Point<T>> result;
+        for (int i = 0; i < n; ++i)
+            if (!removed[i])
+                result.push_back(vertices[i]);
+        return simplified(result);
+    }
+
+    // Lower-left and upper-right corners of the bounding box.
+    pair<Point<T>, Point<T>> bounds() const {
+        Point<T> low = vertices[0], high = vertices[0];
+        for (int i = 1; i < n; ++i) {
+            low.x = min(low.x, vertices[i].x);
+            low.y = min(low.y, vertices[i].y);
+            high.x = max(high.x, vertices[i].x);
+            high.y = max(high.y, vertices[i].y);
+        }
+        return {low, high};
+    }
+
+    // True when the figures share at least one point, touching boundaries included.
+    bool intersects(const Figure& other) const {
+        return intersects(other, Locator<T>(*this), Locator<T>(other));
+    }
+
+    // The same test with the point locators of both figures built by the caller.
+    bool intersects(const Figure& other, const Locator<T>& mine, const Locator<T>& theirs) const {
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < other.n; ++j)
+                if (segments_intersect(vertices[i], vertices[(i + 1) % n], other.vertices[j], other.vertices[(j + 1) % other.n]))
+                    return true;
+        return mine.contains(other.vertices[0]) or theirs.contains(vertices[0]);
+    }
 };
 
 template<typename T>
 class Square: public Figure<T> {
     virtual bool check() const override {
-        return !(fabs(this -> vertices[0].distance(this -> vertices[1]) - this -> vertices[0].distance(this -> vertices[3])) > EPS
-            or fabs(this -> vertices[0].distance(this -> vertices[2]) != this -> vertices[1].distance(this -> vertices[3])) > EPS);
+        return same_length(this -> vertices[0], this -> vertices[1], this -> vertices[0], this -> vertices[3])
+            and same_length(this -> vertices[0], this -> vertices[2], this -> vertices[1], this -> vertices[3]);
     }
     
 public:
@@ -235,6 +780,8 @@ public:
     }
 
     T area() const override {
+        if constexpr (Exact<T>::exact)
+            return Figure<T>::area();
         return length() * length();
     }
 
@@ -265,13 +812,17 @@ public:
     explicit operator double() const override {
         return static_cast<double>(this -> area());
     }
+
+    FigureKind kind() const override {
+        return FigureKind::square;
+    }
 };
 
 template<typename T>
 class Rectangle: public Figure<T> {
     virtual bool check() const override {
-        return !(fabs(this -> vertices[0].distance(this -> vertices[1]) - this -> vertices[2].distance(this -> vertices[3])) > EPS
-            or fabs(this -> vertices[0].distance(this -> vertices[2]) - this -> vertices[1].distance(this -> vertices[3])) > EPS);
+        return same_length(this -> vertices[0], this -> vertices[1], this -> vertices[2], this -> vertices[3])
+            and same_length(this -> vertices[0], this -> vertices[2], this -> vertices[1], this -> vertices[3]);
     }
 
 public:
@@ -286,6 +837,8 @@ public:
     }
 
     T area() const override {
+        if constexpr (Exact<T>::exact)
+            return Figure<T>::area();
         return length() * width();
     }
 
@@ -316,34 +869,45 @@ public:
     explicit operator double() const override {
         return static_cast<double>(this -> area());
     }
+
+    FigureKind kind() const override {
+        return FigureKind::rectangle;
+    }
 };
 
 template<typename T>
 class Trapezoid: public Figure<T> {
     virtual bool check() const override {
-        return !((parallel(this -> vertices[0], this -> vertices[1], this -> vertices[2], this -> vertices[3]) 
-            and not parallel(this -> vertices[0], this -> vertices[2], this -> vertices[1], this -> vertices[3]))
-            or (parallel(this -> vertices[0], this -> vertices[2], this -> vertices[1], this -> vertices[3]) 
-            and not parallel(this -> vertices[0], this -> vertices[1], this -> vertices[2], this -> vertices[3])));
+        return parallel(this -> vertices[0], this -> vertices[1], this -> vertices[2], this -> vertices[3])
+            != parallel(this -> vertices[1], this -> vertices[2], this -> vertices[3], this -> vertices[0]);
     }
-    
+
+    // Lengths of the two parallel sides, in double so that no rounding happens before the result.
+    pair<double, double> bases() const {
+        const Point<T>* v = this -> vertices;
+        if (parallel(v[0], v[1], v[2], v[3]))
+            return {sqrt(sqr_distance(v[0], v[1])), sqrt(sqr_distance(v[2], v[3]))};
+        return {sqrt(sqr_distance(v[1], v[2])), sqrt(sqr_distance(v[3], v[0]))};
+    }
+
 public:
     Trapezoid(): Figure<T>(4) {}
     
     T top() const {
-        if (parallel(this -> vertices[0], this -> vertices[1], this -> vertices[2], this -> vertices[3]))
-            return min(this -> vertices[0].distance(this -> vertices[1]), this -> vertices[2].distance(this -> vertices[3]));
-        return min(this -> vertices[1].distance(this -> vertices[2]), this -> vertices[3].distance(this -> vertices[0]));
+        auto [a, b] = bases();
+        return Exact<T>::from_double(min(a, b));
     }
 
     T bottom() const {
-        if (parallel(this -> vertices[0], this -> vertices[1], this -> vertices[2], this -> vertices[3]))
-            return max(this -> vertices[0].distance(this -> vertices[1]), this -> vertices[2].distance(this -> vertices[3]));
-        return max(this -> vertices[1].distance(this -> vertices[2]), this -> vertices[3].distance(this -> vertices[0]));
+        auto [a, b] = bases();
+        return Exact<T>::from_double(max(a, b));
     }
 
     T height() const {
-        return this -> area() * 2 / (top() + bottom());
+        const Point<T>* v = this -> vertices;
+        double doubled = cross(v[0], v[1], v[2]) + cross(v[0], v[2], v[3]);
+        auto [a, b] = bases();
+        return Exact<T>::from_double(fabs(doubled) / (a + b));
     }
 
     void add_points(const Point<T>& a, const Point<T>& b, const Point<T>& c, const Point<T>& d) {
@@ -373,12 +937,542 @@ public:
     explicit operator double() const override {
         return static_cast<double>(this -> area());
     }
+
+    FigureKind kind() const override {
+        return FigureKind::trapezoid;
+    }
+};
+
+// Quadrilaterals stored as coordinate columns, validated many at a time. The loops are
+// branch-free so the compiler can vectorise them; each result byte is 1 for a valid shape.
+template<typename T>
+class QuadBatch {
+    vector<double> x[4], y[4];
+
+    double sqr_side(size_t i, int a, int b) const {
+        double dx = x[a][i] - x[b][i], dy = y[a][i] - y[b][i];
+        return dx * dx + dy * dy;
+    }
+
+    bool sides_parallel(size_t i, int a, int b, int c, int d) const {
+        return parallel_directions(x[b][i] - x[a][i], y[b][i] - y[a][i], x[d][i] - x[c][i], y[d][i] - y[c][i]);
+    }
+
+public:
+    size_t size() const {
+        return x[0].size();
+    }
+
+    void add(const Point<T>& a, const Point<T>& b, const Point<T>& c, const Point<T>& d) {
+        const Point<T>* corners[] = {&a, &b, &c, &d};
+        for (int k = 0; k < 4; ++k) {
+            x[k].push_back(static_cast<double>(corners[k] -> x));
+            y[k].push_back(static_cast<double>(corners[k] -> y));
+        }
+    }
+
+    vector<uint8_t> squares() const {
+        vector<uint8_t> result(size());
+        for (size_t i = 0; i < size(); ++i)
+            result[i] = equal_lengths(sqr_side(i, 0, 1), sqr_side(i, 0, 3)) & equal_lengths(sqr_side(i, 0, 2), sqr_side(i, 1, 3));
+        return result;
+    }
+
+    vector<uint8_t> rectangles() const {
+        vector<uint8_t> result(size());
+        for (size_t i = 0; i < size(); ++i)
+            result[i] = equal_lengths(sqr_side(i, 0, 1), sqr_side(i, 2, 3)) & equal_lengths(sqr_side(i, 0, 2), sqr_side(i, 1, 3));
+        return result;
+    }
+
+    vector<uint8_t> trapezoids() const {
+        vector<uint8_t> result(size());
+        for (size_t i = 0; i < size(); ++i)
+            result[i] = sides_parallel(i, 0, 1, 2, 3) != sides_parallel(i, 1, 2, 3, 0);
+        return result;
+    }
+};
+
+// Point-in-polygon index: the bounding box is cut into horizontal bands and every band keeps
+// the edges crossing it, so a query runs the crossing test only against its own band. Edges
+// spanning more than max_span bands are stored once in a list every query scans, which keeps
+// the index linear in the number of edges.
+template<typename T>
+class Locator {
+    struct Edge {
+        double x0, y0, x1, y1, slope;
+    };
+
+    static constexpr size_t max_span = 8;
+
+    double bottom = 0.0, top = 0.0, left = 0.0, right = 0.0, scale = 0.0;
+    vector<size_t> offsets;
+    vector<Edge> edges, spanning;
+
+    size_t band(double y) const {
+        return min(offsets.size() - 2, static_cast<size_t>((y - bottom) * scale));
+    }
+
+    static bool crosses(const Edge& e, double x, double y) {
+        return ((e.y0 > y) != (e.y1 > y)) & (x < e.x0 + (y - e.y0) * e.slope);
+    }
+
+public:
+    explicit Locator(const Figure<T>& f) {
+        if (f.n < 3)
+            throw invalid_argument("IMPOSSIBLE_FIGURE");
+        bottom = top = static_cast<double>(f.vertices[0].y);
+        left = right = static_cast<double>(f.vertices[0].x);
+        for (int i = 1; i < f.n; ++i) {
+            bottom = min(bottom, static_cast<double>(f.vertices[i].y));
+            top = max(top, static_cast<double>(f.vertices[i].y));
+            left = min(left, static_cast<double>(f.vertices[i].x));
+            right = max(right, static_cast<double>(f.vertices[i].x));
+        }
+        size_t bands = f.n;
+        scale = top > bottom ? bands / (top - bottom) : 0.0;
+        offsets.assign(bands + 2, 0);
+
+        vector<Edge> all;
+        for (int i = 0; i < f.n; ++i) {
+            const Point<T>& a = f.vertices[i];
+            const Point<T>& b = f.vertices[(i + 1) % f.n];
+            double x0 = static_cast<double>(a.x), y0 = static_cast<double>(a.y);
+            double x1 = static_cast<double>(b.x), y1 = static_cast<double>(b.y);
+            Edge e{x0, y0, x1, y1, y0 == y1 ? 0.0 : (x1 - x0) / (y1 - y0)};
+            if (band(max(y0, y1)) - band(min(y0, y1)) < max_span)
+                all.push_back(e);
+            else
+                spanning.push_back(e);
+        }
+        for (const Edge& e: all)
+            for (size_t k = band(min(e.y0, e.y1)); k <= band(max(e.y0, e.y1)); ++k)
+                ++offsets[k + 1];
+        for (size_t k = 1; k < offsets.size(); ++k)
+            offsets[k] += offsets[k - 1];
+        edges.resize(offsets.back());
+        vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (const Edge& e: all)
+            for (size_t k = band(min(e.y0, e.y1)); k <= band(max(e.y0, e.y1)); ++k)
+                edges[fill[k]++] = e;
+    }
+
+    bool contains(const Point<T>& p) const {
+        double x = static_cast<double>(p.x), y = static_cast<double>(p.y);
+        if (x < left or x > right or y < bottom or y > top)
+            return false;
+        size_t k = band(y);
+        bool inside = false;
+        for (size_t i = offsets[k]; i < offsets[k + 1]; ++i)
+            inside ^= crosses(edges[i], x, y);
+        for (const Edge& e: spanning)
+            inside ^= crosses(e, x, y);
+        return inside;
+    }
+
+    // Some edge lies within distance of p. Only the bands overlapping [y - distance, y + distance]
+    // and the spanning edges are searched.
+    bool near_boundary(const Point<T>& p, double distance) const {
+        double x = static_cast<double>(p.x), y = static_cast<double>(p.y);
+        if (x < left - distance or x > right + distance or y < bottom - distance or y > top + distance)
+            return false;
+        Point<double> q(x, y);
+        auto near = [&](const Edge& e) {
+            return sqr_segment_distance(q, Point<double>(e.x0, e.y0), Point<double>(e.x1, e.y1)) <= distance * distance;
+        };
+        size_t first = band(max(y - distance, bottom)), last = band(min(y + distance, top));
+        return any_of(edges.begin() + offsets[first], edges.begin() + offsets[last + 1], near)
+            or any_of(spanning.begin(), spanning.end(), near);
+    }
+
+    vector<uint64_t> contains(const vector<Point<T>>& points) const {
+        vector<uint64_t> result((points.size() + 63) / 64, 0);
+        parallel_chunks(points.size(), 1 << 12, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                result[i / 64] |= uint64_t(contains(points[i])) << (i % 64);
+        });
+        return result;
+    }
+};
+
+// Read-only mapping of a whole file into memory.
+class MappedFile {
+    const char* bytes = nullptr;
+    size_t length = 0;
+
+public:
+    explicit MappedFile(const string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw invalid_argument("FILE_ERROR");
+        struct stat info;
+        if (fstat(fd, &info) < 0) {
+            close(fd);
+            throw invalid_argument("FILE_ERROR");
+        }
+        length = info.st_size;
+        void* mapping = length > 0 ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+        close(fd);
+        if (mapping == MAP_FAILED)
+            throw invalid_argument("FILE_ERROR");
+        bytes = static_cast<const char*>(mapping);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator =(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (bytes != nullptr)
+            munmap(const_cast<char*>(bytes), length);
+    }
+
+    const char* data() const {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+};
+
+struct LoadError {
+    size_t line;
+    string reason;
+};
+
+template<typename T>
+class Array;
+
+// Convex hull of a point cloud, counter-clockwise without collinear vertices. Points strictly
+// inside the quadrilateral of the leftmost, lowest, rightmost and highest points are dropped
+// first (Akl-Toussaint), the rest go through Andrew's monotone chain.
+template<typename T>
+Figure<T> convex_hull(span<const Point<T>> points) {
+    if (points.empty())
+        throw invalid_argument("IMPOSSIBLE_FIGURE");
+    const size_t grain = 1 << 14;
+    using Extremes = array<size_t, 4>;
+    vector<Extremes> partial((points.size() + grain - 1) / grain);
+    parallel_chunks(points.size(), grain, [&](size_t begin, size_t end) {
+        Extremes e = {begin, begin, begin, begin};
+        for (size_t i = begin + 1; i < end; ++i) {
+            if (points[i].x < points[e[0]].x) e[0] = i;
+            if (points[i].y < points[e[1]].y) e[1] = i;
+            if (points[i].x > points[e[2]].x) e[2] = i;
+            if (points[i].y > points[e[3]].y) e[3] = i;
+        }
+        partial[begin / grain] = e;
+    });
+    Extremes e = partial[0];
+    for (const Extremes& p: partial) {
+        if (points[p[0]].x < points[e[0]].x) e[0] = p[0];
+        if (points[p[1]].y < points[e[1]].y) e[1] = p[1];
+        if (points[p[2]].x > points[e[2]].x) e[2] = p[2];
+        if (points[p[3]].y > points[e[3]].y) e[3] = p[3];
+    }
+
+    vector<char> keep(points.size());
+    parallel_chunks(points.size(), grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            bool inside = true;
+            for (int k = 0; k < 4 and inside; ++k)
+                inside = orient(points[e[k]], points[e[(k + 1) % 4]], points[i]) > 0;
+            keep[i] = !inside;
+        }
+    });
+    vector<Point<T>> candidates;
+    for (size_t i = 0; i < points.size(); ++i)
+        if (keep[i])
+            candidates.push_back(points[i]);
+
+    parallel_sort(candidates, [](const Point<T>& a, const Point<T>& b) {
+        return a.x < b.x or (a.x == b.x and a.y < b.y);
+    });
+    candidates.erase(unique(candidates.begin(), candidates.end(), [](const Point<T>& a, const Point<T>& b) {
+        return a.x == b.x and a.y == b.y;
+    }), candidates.end());
+    if (candidates.size() < 3)
+        throw invalid_argument("IMPOSSIBLE_FIGURE");
+
+    vector<Point<T>> hull(2 * candidates.size());
+    size_t k = 0;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        while (k >= 2 and orient(hull[k - 2], hull[k - 1], candidates[i]) <= 0)
+            --k;
+        hull[k++] = candidates[i];
+    }
+    for (size_t i = candidates.size() - 1, lower = k + 1; i-- > 0;) {
+        while (k >= lower and orient(hull[k - 2], hull[k - 1], candidates[i]) <= 0)
+            --k;
+        hull[k++] = candidates[i];
+    }
+    hull.resize(k - 1);
+    if (hull.size() < 3)
+        throw invalid_argument("IMPOSSIBLE_FIGURE");
+    return Figure<T>(hull);
+}
+
+template<typename T>
+Figure<T> convex_hull(const vector<Point<T>>& points) {
+    return convex_hull(span<const Point<T>>(points));
+}
+
+// Bulk reader for files with one figure per line in the get_info() format.
+template<typename T>
+class Loader {
+    template<typename V>
+    static bool parse(const char*& p, const char* end, V& value) {
+        while (p < end and (*p == ' ' or *p == '\t'))
+            ++p;
+        if constexpr (!is_arithmetic_v<V>) {
+            double parsed;
+            if (!parse(p, end, parsed))
+                return false;
+            value = V(parsed);
+            return true;
+        }
+        else {
+            auto [next, error] = from_chars(p, end, value);
+            if (error != errc())
+                return false;
+            if constexpr (is_floating_point_v<V>)
+                if (!isfinite(value))
+                    return false;
+            p = next;
+            return true;
+        }
+    }
+
+    static size_t tokens(const char* p, const char* end) {
+        size_t result = 0;
+        for (bool blank = true; p < end; ++p) {
+            bool space = *p == ' ' or *p == '\t';
+            result += blank and !space;
+            blank = space;
+        }
+        return result;
+    }
+
+    // The count is checked against the tokens left on the line before anything is allocated.
+    template<template<typename> class Shape>
+    static Figure<T>* parse_line(const char* p, const char* end, string& reason) {
+        int count;
+        if (!parse(p, end, count) or count < 0 or tokens(p, end) != 2 * static_cast<size_t>(count)) {
+            reason = "PARSE_ERROR";
+            return nullptr;
+        }
+        if (count < 3) {
+            reason = "IMPOSSIBLE_FIGURE";
+            return nullptr;
+        }
+        Shape<T>* shape = new Shape<T>;
+        Figure<T>& f = *shape;
+        if (f.n == -1) {
+            f.n = count;
+            f.vertices = new Point<T>[count];
+        }
+        bool parsed = f.n == count;
+        for (int i = 0; parsed and i < count; ++i)
+            parsed = parse(p, end, f.vertices[i].x) and parse(p, end, f.vertices[i].y);
+        while (p < end and (*p == ' ' or *p == '\t'))
+            ++p;
+        if (!parsed or p != end)
+            reason = "PARSE_ERROR";
+        else if (!f.check())
+            reason = "IMPOSSIBLE_FIGURE";
+        else
+            return shape;
+        delete shape;
+        return nullptr;
+    }
+
+public:
+    // Figures are appended to out in file order, bad records are skipped and reported with
+    // their 1-based line numbers instead of throwing.
+    template<template<typename> class Shape = Figure>
+    static vector<LoadError> load(const string& path, Array<T>& out) {
+        MappedFile file(path);
+        const char* text = file.data();
+        size_t size = file.size();
+
+        size_t parts = max(1u, thread::hardware_concurrency()) * 4;
+        vector<size_t> cuts(parts + 1, size);
+        cuts[0] = 0;
+        for (size_t k = 1; k < parts; ++k) {
+            size_t at = max(cuts[k - 1], size * k / parts);
+            while (at > 0 and at < size and text[at - 1] != '\n')
+                ++at;
+            cuts[k] = at;
+        }
+
+        vector<vector<Figure<T>*>> figures(parts);
+        vector<vector<LoadError>> errors(parts);
+        vector<size_t> lines(parts, 0);
+        parallel_chunks(parts, 1, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                const char* p = text + cuts[k];
+                const char* stop = text + cuts[k + 1];
+                while (p < stop) {
+                    const char* eol = find(p, stop, '\n');
+                    const char* last = eol;
+                    if (last > p and last[-1] == '\r')
+                        --last;
+                    ++lines[k];
+                    if (find_if(p, last, [](char c) { return c != ' ' and c != '\t'; }) != last) {
+                        string reason;
+                        try {
+                            if (Figure<T>* f = parse_line<Shape>(p, last, reason))
+                                figures[k].push_back(f);
+                        }
+                        catch (const exception& e) {
+                            reason = e.what();
+                        }
+                        if (!reason.empty())
+                            errors[k].push_back({lines[k], reason});
+                    }
+                    p = eol == stop ? stop : eol + 1;
+                }
+            }
+        });
+
+        vector<LoadError> result;
+        size_t first_line = 0;
+        for (size_t k = 0; k < parts; ++k) {
+            for (Figure<T>* f: figures[k])
+                out.add(f);
+            for (LoadError& e: errors[k])
+                result.push_back({first_line + e.line, move(e.reason)});
+            first_line += lines[k];
+        }
+        return result;
+    }
+};
+
+// Simplified copies of a figure with tolerances doubling from the finest level. Queries run on
+// the coarsest level first and only move to a finer one when the answer could differ there.
+template<typename T>
+class LevelOfDetail {
+    vector<Figure<T>> levels;
+    vector<Locator<T>> locators;
+    vector<double> tolerances;
+
+public:
+    LevelOfDetail(const Figure<T>& f, T finest, size_t count) {
+        levels.push_back(f);
+        tolerances.push_back(0.0);
+        for (size_t k = 0; k < count; ++k) {
+            double tolerance = static_cast<double>(finest) * (1 << k);
+            levels.push_back(f.simplify_dp(static_cast<T>(tolerance)));
+            tolerances.push_back(tolerance);
+        }
+        for (const Figure<T>& level: levels)
+            locators.emplace_back(level);
+    }
+
+    size_t size() const {
+        return levels.size();
+    }
+
+    // Level 0 is the original figure, higher levels are coarser.
+    const Figure<T>& level(size_t index) const {
+        if (index >= levels.size())
+            throw invalid_argument("INVALID_INDEX");
+        return levels[index];
+    }
+
+    // Coarsest level whose outline is within tolerance of the original.
+    const Figure<T>& coarsest(T tolerance) const {
+        size_t k = levels.size() - 1;
+        while (k > 0 and tolerances[k] > static_cast<double>(tolerance))
+            --k;
+        return levels[k];
+    }
+
+    // A level's outline is within its tolerance of the original, so points farther than that
+    // from the outline are classified the same way as by the original figure. The distance check
+    // only looks at the edges in the query's bands of the level's locator.
+    bool contains(const Point<T>& p) const {
+        for (size_t k = levels.size() - 1; k > 0; --k)
+            if (!locators[k].near_boundary(p, tolerances[k]))
+                return locators[k].contains(p);
+        return locators[0].contains(p);
+    }
+};
+
+// Closed intervals on y, inserted and erased during a sweep, reporting the ones that overlap
+// a query in O(log n + k). An interval tree over a fixed set of coordinates yields the intervals
+// containing the query's low end, a set ordered by low end yields the ones starting inside it.
+class YIntervals {
+    vector<double> keys;
+    vector<set<pair<double, int>>> by_low, by_high;
+    set<pair<double, int>> lows;
+
+    // Tree node holding [low, high]: the first key on the binary search path that lies inside it.
+    size_t node(double low, double high) const {
+        size_t first = 0, last = keys.size();
+        while (true) {
+            size_t mid = first + (last - first) / 2;
+            if (high < keys[mid])
+                last = mid;
+            else if (low > keys[mid])
+                first = mid + 1;
+            else
+                return mid;
+        }
+    }
+
+public:
+    // Every interval end must be one of the sorted, distinct coordinates.
+    explicit YIntervals(vector<double> coordinates): keys(move(coordinates)), by_low(keys.size()), by_high(keys.size()) {}
+
+    void insert(double low, double high, int id) {
+        size_t k = node(low, high);
+        by_low[k].insert({low, id});
+        by_high[k].insert({high, id});
+        lows.insert({low, id});
+    }
+
+    void erase(double low, double high, int id) {
+        size_t k = node(low, high);
+        by_low[k].erase({low, id});
+        by_high[k].erase({high, id});
+        lows.erase({low, id});
+    }
+
+    void overlapping(double low, double high, vector<int>& out) const {
+        size_t first = 0, last = keys.size();
+        while (first < last) {
+            size_t mid = first + (last - first) / 2;
+            if (low < keys[mid]) {
+                for (auto& [start, id]: by_low[mid]) {
+                    if (start > low)
+                        break;
+                    out.push_back(id);
+                }
+                last = mid;
+            }
+            else if (low > keys[mid]) {
+                for (auto it = by_high[mid].rbegin(); it != by_high[mid].rend() and it -> first >= low; ++it)
+                    out.push_back(it -> second);
+                first = mid + 1;
+            }
+            else {
+                for (auto& [start, id]: by_low[mid])
+                    out.push_back(id);
+                break;
+            }
+        }
+        for (auto it = lows.upper_bound({low, numeric_limits<int>::max()}); it != lows.end() and it -> first <= high; ++it)
+            out.push_back(it -> second);
+    }
 };
 
 template<typename T>
 class Array {
     vector<Figure<T>*> data;
 
+    friend class FigureFile<T>;
+
 public:
     Array() = default;
 
@@ -407,6 +1501,514 @@ public:
     int size() const {
         return data.size();
     }
+
+    vector<Point<T>> centers() const {
+        vector<Point<T>> result(data.size());
+        parallel_chunks(data.size(), 1 << 12, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                result[i] = data[i] -> center();
+        });
+        return result;
+    }
+
+    // Areas of all figures, computed once so that aggregates do not repeat the virtual calls.
+    vector<double> areas() const {
+        vector<double> result(data.size());
+        parallel_chunks(data.size(), 1 << 12, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                result[i] = static_cast<double>(*data[i]);
+        });
+        return result;
+    }
+
+    double total_area() const {
+        const size_t grain = 1 << 12;
+        vector<double> keys = areas();
+        vector<double> partial((keys.size() + grain - 1) / grain, 0.0);
+        parallel_chunks(keys.size(), grain, [&](size_t begin, size_t end) {
+            partial[begin / grain] = accumulate(keys.begin() + begin, keys.begin() + end, 0.0);
+        });
+        return accumulate(partial.begin(), partial.end(), 0.0);
+    }
+
+    void sort_by_area() {
+        vector<double> keys = areas();
+        vector<pair<double, Figure<T>*>> order(data.size());
+        for (size_t i = 0; i < data.size(); ++i)
+            order[i] = {keys[i], data[i]};
+        parallel_sort(order, [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+        for (size_t i = 0; i < data.size(); ++i)
+            data[i] = order[i].second;
+    }
+
+    // Indices of the k largest figures, largest first.
+    vector<int> top_k_by_area(size_t k) const {
+        const size_t grain = 1 << 12;
+        vector<double> keys = areas();
+        k = min(k, keys.size());
+        auto larger = [&keys](int a, int b) {
+            return keys[a] > keys[b] or (keys[a] == keys[b] and a < b);
+        };
+        vector<int> index(keys.size());
+        iota(index.begin(), index.end(), 0);
+        vector<size_t> kept((keys.size() + grain - 1) / grain, 0);
+        parallel_chunks(keys.size(), grain, [&](size_t begin, size_t end) {
+            size_t keep = min(k, end - begin);
+            nth_element(index.begin() + begin, index.begin() + begin + keep, index.begin() + end, larger);
+            kept[begin / grain] = keep;
+        });
+        vector<int> result;
+        for (size_t c = 0; c < kept.size(); ++c)
+            result.insert(result.end(), index.begin() + c * grain, index.begin() + c * grain + kept[c]);
+        partial_sort(result.begin(), result.begin() + k, result.end(), larger);
+        result.resize(k);
+        return result;
+    }
+
+    // Counts of figures per equal-width area bin between the smallest and the largest area.
+    vector<size_t> area_histogram(size_t bins) const {
+        if (bins == 0)
+            throw invalid_argument("INVALID_BINS");
+        vector<double> keys = areas();
+        vector<size_t> result(bins, 0);
+        if (keys.empty())
+            return result;
+        auto [low, high] = minmax_element(keys.begin(), keys.end());
+        double bottom = *low, width = (*high - *low) / bins;
+        mutex merge;
+        parallel_chunks(keys.size(), 1 << 12, [&](size_t begin, size_t end) {
+            vector<size_t> local(bins, 0);
+            for (size_t i = begin; i < end; ++i)
+                ++local[width > 0 ? min(bins - 1, static_cast<size_t>((keys[i] - bottom) / width)) : 0];
+            lock_guard<mutex> lock(merge);
+            for (size_t b = 0; b < bins; ++b)
+                result[b] += local[b];
+        });
+        return result;
+    }
+
+    // Index pairs (i < j) of intersecting figures. Candidates come from a sweep over bounding
+    // boxes sorted by their left edge, exact tests on the candidates run in parallel.
+    vector<pair<int, int>> overlaps() const {
+        vector<pair<Point<T>, Point<T>>> boxes(data.size());
+        parallel_chunks(data.size(), 1 << 10, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                boxes[i] = data[i] -> bounds();
+        });
+        vector<int> order(data.size());
+        iota(order.begin(), order.end(), 0);
+        sort(order.begin(), order.end(), [&boxes](int a, int b) {
+            return boxes[a].first.x < boxes[b].first.x;
+        });
+
+        vector<double> ys;
+        for (auto& [low, high]: boxes) {
+            ys.push_back(static_cast<double>(low.y));
+            ys.push_back(static_cast<double>(high.y));
+        }
+        sort(ys.begin(), ys.end());
+        ys.erase(unique(ys.begin(), ys.end()), ys.end());
+        YIntervals active(ys);
+
+        vector<pair<int, int>> candidates;
+        priority_queue<pair<double, int>, vector<pair<double, int>>, greater<>> leaving;
+        vector<int> found;
+        for (int i: order) {
+            double left = static_cast<double>(boxes[i].first.x);
+            while (!leaving.empty() and leaving.top().first < left) {
+                int j = leaving.top().second;
+                leaving.pop();
+                active.erase(static_cast<double>(boxes[j].first.y), static_cast<double>(boxes[j].second.y), j);
+            }
+            double low = static_cast<double>(boxes[i].first.y), high = static_cast<double>(boxes[i].second.y);
+            found.clear();
+            active.overlapping(low, high, found);
+            for (int j: found)
+                candidates.push_back({min(i, j), max(i, j)});
+            active.insert(low, high, i);
+            leaving.push({static_cast<double>(boxes[i].second.x), i});
+        }
+
+        vector<unique_ptr<Locator<T>>> locators(data.size());
+        vector<char> used(data.size(), 0);
+        for (auto [a, b]: candidates)
+            used[a] = used[b] = 1;
+        parallel_chunks(data.size(), 1 << 8, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                if (used[i])
+                    locators[i] = make_unique<Locator<T>>(*data[i]);
+        });
+        vector<char> hit(candidates.size());
+        parallel_chunks(candidates.size(), 1 << 8, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                auto [a, b] = candidates[k];
+                hit[k] = data[a] -> intersects(*data[b], *locators[a], *locators[b]);
+            }
+        });
+        vector<pair<int, int>> result;
+        for (size_t k = 0; k < candidates.size(); ++k)
+            if (hit[k])
+                result.push_back(candidates[k]);
+        sort(result.begin(), result.end());
+        return result;
+    }
+
+    // Groups of congruent figures (see Figure::congruent), each sorted by index, ordered by their
+    // first index. Every figure is compared with the first figure of each candidate group, never
+    // with other members, so matches within eps do not chain across groups. Candidate groups are
+    // looked up by signature: kind, vertex count, area and the longest edges, each quantised to
+    // its tolerance, so only the neighbouring cells are probed. The area cell is wide enough to
+    // cover the area change of an outline whose edges and turns are all off by eps.
+    vector<vector<int>> group_congruent() const {
+        vector<pair<vector<double>, vector<double>>> outlines(data.size());
+        vector<vector<double>> signatures(data.size());
+        parallel_chunks(data.size(), 1 << 10, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                outlines[i] = data[i] -> outline();
+                signatures[i] = data[i] -> signature();
+            }
+        });
+
+        double eps = 0.0, area_width = 0.0;
+        for (size_t i = 0; i < data.size(); ++i)
+            eps = max(eps, data[i] -> signature_eps());
+        for (const vector<double>& sig: signatures) {
+            double perimeter = accumulate(sig.begin() + 1, sig.end(), 0.0);
+            area_width = max(area_width, (sig.size() - 1) * eps * (1 + perimeter) * perimeter);
+        }
+        area_width = max(area_width, eps);
+
+        constexpr size_t keyed = 3;
+        using Cell = array<long long, keyed + 3>;
+        struct CellHash {
+            size_t operator ()(const Cell& cell) const {
+                size_t h = 0;
+                for (long long c: cell)
+                    h ^= hash<long long>()(c) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+                return h;
+            }
+        };
+        unordered_map<Cell, vector<int>, CellHash> cells;
+        vector<vector<int>> groups;
+
+        auto similar = [&](const vector<double>& a, const vector<double>& b, double tolerance) {
+            if (a.size() != b.size() or fabs(a[0] - b[0]) >= area_width)
+                return false;
+            for (size_t d = 1; d < a.size(); ++d)
+                if (fabs(a[d] - b[d]) >= tolerance)
+                    return false;
+            return true;
+        };
+
+        size_t neighbours = 1;
+        for (size_t d = 2; d < keyed + 3; ++d)
+            neighbours *= 3;
+        for (size_t i = 0; i < data.size(); ++i) {
+            const vector<double>& sig = signatures[i];
+            double tolerance = data[i] -> signature_eps();
+            Cell cell = {static_cast<long long>(data[i] -> kind()), static_cast<long long>(sig.size()),
+                static_cast<long long>(floor(sig[0] / area_width))};
+            for (size_t d = 0; d < keyed; ++d)
+                cell[d + 3] = d + 1 < sig.size() ? static_cast<long long>(floor(sig[d + 1] / eps)) : 0;
+
+            int found = -1;
+            for (size_t code = 0; found == -1 and code < neighbours; ++code) {
+                Cell probe = cell;
+                for (size_t d = 2, rest = code; d < probe.size(); ++d, rest /= 3)
+                    probe[d] += static_cast<long long>(rest % 3) - 1;
+                auto it = cells.find(probe);
+                if (it == cells.end())
+                    continue;
+                for (int g: it -> second) {
+                    int first = groups[g][0];
+                    if (similar(signatures[first], sig, tolerance) and Figure<T>::same_outline(outlines[first], outlines[i], tolerance)) {
+                        found = g;
+                        break;
+                    }
+                }
+            }
+            if (found == -1) {
+                found = groups.size();
+                groups.emplace_back();
+                cells[cell].push_back(found);
+            }
+            groups[found].push_back(i);
+        }
+        return groups;
+    }
+};
+
+// k-d tree over the figure centers of an Array, computed once at construction. The tree is
+// implicit: every range of order is split at its median along x or y by depth.
+template<typename T>
+class KdTree {
+    vector<Point<T>> centers;
+    vector<int> order;
+
+    static double coordinate(const Point<T>& p, int axis) {
+        return static_cast<double>(axis == 0 ? p.x : p.y);
+    }
+
+    void build(size_t begin, size_t end, int depth, int spawn) {
+        if (end - begin <= 1)
+            return;
+        size_t middle = begin + (end - begin) / 2;
+        int axis = depth % 2;
+        nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](int a, int b) {
+            return coordinate(centers[a], axis) < coordinate(centers[b], axis);
+        });
+        if (spawn > 0 and end - begin > (1 << 14)) {
+            thread left([=, this] { build(begin, middle, depth + 1, spawn - 1); });
+            build(middle + 1, end, depth + 1, spawn - 1);
+            left.join();
+        }
+        else {
+            build(begin, middle, depth + 1, 0);
+            build(middle + 1, end, depth + 1, 0);
+        }
+    }
+
+    void nearest(const Point<T>& p, size_t k, size_t begin, size_t end, int depth, vector<pair<double, int>>& heap) const {
+        if (begin >= end)
+            return;
+        size_t middle = begin + (end - begin) / 2;
+        int i = order[middle];
+        double d = sqr_distance(p, centers[i]);
+        if (heap.size() < k or d < heap.front().first) {
+            heap.push_back({d, i});
+            push_heap(heap.begin(), heap.end());
+            if (heap.size() > k) {
+                pop_heap(heap.begin(), heap.end());
+                heap.pop_back();
+            }
+        }
+        double delta = coordinate(p, depth % 2) - coordinate(centers[i], depth % 2);
+        auto [first, second] = delta < 0 ? pair(begin, middle) : pair(middle + 1, end);
+        auto [other_first, other_second] = delta < 0 ? pair(middle + 1, end) : pair(begin, middle);
+        nearest(p, k, first, second, depth + 1, heap);
+        if (heap.size() < k or delta * delta < heap.front().first)
+            nearest(p, k, other_first, other_second, depth + 1, heap);
+    }
+
+    void within(const Point<T>& p, double r2, size_t begin, size_t end, int depth, vector<int>& result) const {
+        if (begin >= end)
+            return;
+        size_t middle = begin + (end - begin) / 2;
+        int i = order[middle];
+        if (sqr_distance(p, centers[i]) <= r2)
+            result.push_back(i);
+        double delta = coordinate(p, depth % 2) - coordinate(centers[i], depth % 2);
+        if (delta <= 0 or delta * delta <= r2)
+            within(p, r2, begin, middle, depth + 1, result);
+        if (delta >= 0 or delta * delta <= r2)
+            within(p, r2, middle + 1, end, depth + 1, result);
+    }
+
+public:
+    explicit KdTree(const Array<T>& figures): centers(figures.centers()), order(centers.size()) {
+        iota(order.begin(), order.end(), 0);
+        int spawn = 0;
+        while ((1u << spawn) < thread::hardware_concurrency())
+            ++spawn;
+        build(0, order.size(), 0, spawn);
+    }
+
+    size_t size() const {
+        return centers.size();
+    }
+
+    const Point<T>& center(int index) const {
+        return centers.at(index);
+    }
+
+    // Indices of the k figures with the closest centers, closest first.
+    vector<int> nearest(const Point<T>& p, size_t k) const {
+        vector<pair<double, int>> heap;
+        if (k > 0)
+            nearest(p, k, 0, order.size(), 0, heap);
+        sort_heap(heap.begin(), heap.end());
+        vector<int> result;
+        for (auto& [d, i]: heap)
+            result.push_back(i);
+        return result;
+    }
+
+    vector<vector<int>> nearest(const vector<Point<T>>& probes, size_t k) const {
+        vector<vector<int>> result(probes.size());
+        parallel_chunks(probes.size(), 1 << 8, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                result[i] = nearest(probes[i], k);
+        });
+        return result;
+    }
+
+    // Indices of the figures whose centers are at most r away from p, in ascending order.
+    vector<int> within(const Point<T>& p, T r) const {
+        vector<int> result;
+        within(p, static_cast<double>(r) * static_cast<double>(r), 0, order.size(), 0, result);
+        sort(result.begin(), result.end());
+        return result;
+    }
+
+    vector<vector<int>> within(const vector<Point<T>>& probes, T r) const {
+        vector<vector<int>> result(probes.size());
+        parallel_chunks(probes.size(), 1 << 8, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                result[i] = within(probes[i], r);
+        });
+        return result;
+    }
+
+    // Index pairs (i < j) of figures whose centers are at most r apart.
+    vector<pair<int, int>> pairs_within(T r) const {
+        vector<vector<int>> close = within(centers, r);
+        vector<pair<int, int>> result;
+        for (size_t i = 0; i < close.size(); ++i)
+            for (int j: close[i])
+                if (j > static_cast<int>(i))
+                    result.push_back({static_cast<int>(i), j});
+        return result;
+    }
+};
+
+// Binary figure container: a header with the figure count, a table of record offsets for
+// random access and the records themselves. A record is its kind, the vertex count and
+// the x and y coordinates as two raw columns.
+template<typename T>
+class FigureFile {
+    static_assert(is_trivially_copyable_v<T>);
+
+    struct Header {
+        char magic[4];
+        uint32_t value_size;
+        uint64_t count;
+    };
+
+    struct Record {
+        FigureKind kind;
+        uint8_t padding[3];
+        uint32_t n;
+    };
+
+    MappedFile file;
+    const Header* header;
+    const uint64_t* offsets;
+
+    const Record& record(size_t index) const {
+        if (index >= header -> count)
+            throw invalid_argument("INVALID_INDEX");
+        return *reinterpret_cast<const Record*>(file.data() + offsets[index]);
+    }
+
+    // The kind is known and its vertex count agrees with it, so operator [] cannot fail on a
+    // record that passed the constructor.
+    static bool valid(const Record& r) {
+        switch (r.kind) {
+            case FigureKind::figure: return r.n >= 3 and r.n <= static_cast<uint32_t>(numeric_limits<int>::max());
+            case FigureKind::square:
+            case FigureKind::rectangle:
+            case FigureKind::trapezoid: return r.n == 4;
+            default: return false;
+        }
+    }
+
+    static Figure<T>* make(FigureKind kind) {
+        switch (kind) {
+            case FigureKind::figure: return new Figure<T>;
+            case FigureKind::square: return new Square<T>;
+            case FigureKind::rectangle: return new Rectangle<T>;
+            case FigureKind::trapezoid: return new Trapezoid<T>;
+            default: throw invalid_argument("FILE_ERROR");
+        }
+    }
+
+public:
+    explicit FigureFile(const string& path): file(path) {
+        header = reinterpret_cast<const Header*>(file.data());
+        offsets = reinterpret_cast<const uint64_t*>(file.data() + sizeof(Header));
+        if (file.size() < sizeof(Header) or memcmp(header -> magic, "FIGB", 4) != 0 or header -> value_size != sizeof(T)
+            or header -> count > (file.size() - sizeof(Header)) / sizeof(uint64_t))
+            throw invalid_argument("FILE_ERROR");
+        for (size_t i = 0; i < header -> count; ++i)
+            if (offsets[i] % alignof(uint64_t) != 0 or offsets[i] > file.size() - sizeof(Record)
+                or record(i).n > (file.size() - offsets[i] - sizeof(Record)) / (2 * sizeof(T)) or !valid(record(i)))
+                throw invalid_argument("FILE_ERROR");
+    }
+
+    static void save(const string& path, const Array<T>& figures) {
+        ofstream os(path, ios::binary);
+        if (!os)
+            throw invalid_argument("FILE_ERROR");
+        Header h = {{'F', 'I', 'G', 'B'}, sizeof(T), figures.data.size()};
+        os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        uint64_t offset = sizeof(Header) + figures.data.size() * sizeof(uint64_t);
+        for (const Figure<T>* f: figures.data) {
+            os.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+            offset += sizeof(Record) + 2 * f -> n * sizeof(T);
+        }
+        vector<T> column;
+        for (const Figure<T>* f: figures.data) {
+            Record r = {f -> kind(), {}, static_cast<uint32_t>(f -> n)};
+            os.write(reinterpret_cast<const char*>(&r), sizeof(r));
+            column.resize(2 * f -> n);
+            for (int i = 0; i < f -> n; ++i) {
+                column[i] = f -> vertices[i].x;
+                column[f -> n + i] = f -> vertices[i].y;
+            }
+            os.write(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(T));
+        }
+        if (!os)
+            throw invalid_argument("FILE_ERROR");
+    }
+
+    size_t size() const {
+        return header -> count;
+    }
+
+    FigureKind kind(size_t index) const {
+        return record(index).kind;
+    }
+
+    int vertex_count(size_t index) const {
+        return record(index).n;
+    }
+
+    // Coordinate columns point straight into the mapped file.
+    const T* xs(size_t index) const {
+        return reinterpret_cast<const T*>(&record(index) + 1);
+    }
+
+    const T* ys(size_t index) const {
+        return xs(index) + record(index).n;
+    }
+
+    Figure<T>* operator [](size_t index) const {
+        const Record& r = record(index);
+        Figure<T>* f = make(r.kind);
+        if (f -> n != -1 and f -> n != static_cast<int>(r.n)) {
+            delete f;
+            throw invalid_argument("FILE_ERROR");
+        }
+        if (f -> n == -1) {
+            f -> n = r.n;
+            f -> vertices = new Point<T>[r.n];
+        }
+        const T* x = xs(index);
+        for (uint32_t i = 0; i < r.n; ++i)
+            f -> vertices[i] = Point<T>(x[i], x[r.n + i]);
+        return f;
+    }
+
+    void load(Array<T>& out) const {
+        size_t first = out.data.size();
+        out.data.resize(first + size(), nullptr);
+        parallel_chunks(size(), 1 << 10, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                out.data[first + i] = (*this)[i];
+        });
+    }
 };
 
 int main() {
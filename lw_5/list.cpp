@@ -2,13 +2,350 @@
 #include <cstdlib>
 #include <map>
 #include <concepts>
+#include <limits>
+#include <new>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <memory_resource>
+#include <bit>
+#include <sys/mman.h>
+#include <chrono>
+#include <stdexcept>
+#include <mutex>
+#include <algorithm>
 
 using namespace std;
 
+enum class Backing { heap, mapped };
+
+// Compile with ALLOCATOR_STATS to count pool activity, otherwise the counters do not exist.
+#ifdef ALLOCATOR_STATS
+struct AllocatorStats {
+    size_t live = 0;
+    size_t peak = 0;
+    size_t allocations = 0;
+    size_t deallocations = 0;
+    size_t chunks = 0;
+    size_t free_slots = 0;
+    size_t failed = 0;
+    chrono::steady_clock::time_point since = chrono::steady_clock::now();
+
+    double seconds() const {
+        return chrono::duration<double>(chrono::steady_clock::now() - since).count();
+    }
+
+    double allocation_rate() const {
+        return allocations / max(seconds(), 1e-9);
+    }
+
+    double deallocation_rate() const {
+        return deallocations / max(seconds(), 1e-9);
+    }
+
+    AllocatorStats& operator +=(const AllocatorStats& other) {
+        live += other.live;
+        peak += other.peak;
+        allocations += other.allocations;
+        deallocations += other.deallocations;
+        chunks += other.chunks;
+        free_slots += other.free_slots;
+        failed += other.failed;
+        since = min(since, other.since);
+        return *this;
+    }
+
+    friend ostream& operator <<(ostream& os, const AllocatorStats& stats) {
+        return os << "live " << stats.live << ", peak " << stats.peak << ", chunks " << stats.chunks
+            << ", free " << stats.free_slots << ", failed " << stats.failed
+            << ", allocations " << stats.allocations << " (" << stats.allocation_rate() << "/s)"
+            << ", deallocations " << stats.deallocations << " (" << stats.deallocation_rate() << "/s)\n";
+    }
+};
+#define ALLOCATOR_STAT(statement) statement
+#else
+#define ALLOCATOR_STAT(statement)
+#endif
+
+// Pool of fixed-size slots. Memory comes in chunks of at least block slots, every chunk keeps
+// its own intrusive free list and live count, and chunks with room are chained into a partial
+// list. Chunks are aligned to their size, so a slot finds its chunk by masking its address.
+// Mapped backing reserves address space with mmap in regions of at least a huge page, commits
+// it a chunk at a time, asks for transparent huge pages and hands the pages of a chunk that
+// becomes empty back to the OS. Empty heap chunks are kept for reuse.
+class Pool {
+    struct Chunk {
+        Chunk* prev;
+        Chunk* next;
+        Chunk* owned;
+        void* free;
+        size_t live;
+        size_t carved;
+        bool partial;
+    };
+
+    struct Region {
+        unsigned char* base;
+        size_t size;
+        size_t used;
+    };
+
+    static constexpr size_t page = 4096;
+    static constexpr size_t huge_page = 2 << 20;
+    static constexpr size_t chunks_per_region = 64;
+
+    size_t _slot_size, _alignment, _block, _header, _chunk_bytes, _capacity;
+    Backing _backing;
+    Chunk* _partial = nullptr;
+    Chunk* _owned = nullptr;
+    vector<Chunk*> _empty;
+    vector<Region> _regions;
+#ifdef ALLOCATOR_STATS
+    AllocatorStats _stats;
+    ostream* _dump = nullptr;
+    size_t _dump_period = 0;
+#endif
+
+    static size_t round_up(size_t size, size_t alignment) {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    unsigned char* slot(Chunk* chunk, size_t index) const {
+        return reinterpret_cast<unsigned char*>(chunk) + _header + index * _slot_size;
+    }
+
+    Chunk* chunk_of(void* p) const {
+        return reinterpret_cast<Chunk*>(reinterpret_cast<uintptr_t>(p) & ~(_chunk_bytes - 1));
+    }
+
+    void link_partial(Chunk* chunk) {
+        chunk->prev = nullptr;
+        chunk->next = _partial;
+        if (_partial)
+            _partial->prev = chunk;
+        _partial = chunk;
+        chunk->partial = true;
+    }
+
+    void unlink_partial(Chunk* chunk) {
+        if (chunk->prev)
+            chunk->prev->next = chunk->next;
+        else
+            _partial = chunk->next;
+        if (chunk->next)
+            chunk->next->prev = chunk->prev;
+        chunk->partial = false;
+    }
+
+    void reserve() {
+        size_t size = max(_chunk_bytes * chunks_per_region, huge_page), alignment = max(_chunk_bytes, huge_page);
+        void* raw = mmap(nullptr, size + alignment, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (raw == MAP_FAILED)
+            throw bad_alloc();
+        unsigned char* start = static_cast<unsigned char*>(raw);
+        unsigned char* base = reinterpret_cast<unsigned char*>(round_up(reinterpret_cast<uintptr_t>(start), alignment));
+        if (base > start)
+            munmap(start, base - start);
+        if (start + size + alignment > base + size)
+            munmap(base + size, start + size + alignment - (base + size));
+        madvise(base, size, MADV_HUGEPAGE);
+        _regions.push_back({base, size, 0});
+    }
+
+    void* commit() {
+        if (_regions.empty() or _regions.back().used == _regions.back().size)
+            reserve();
+        Region& region = _regions.back();
+        void* chunk = region.base + region.used;
+        if (mprotect(chunk, _chunk_bytes, PROT_READ | PROT_WRITE) != 0)
+            throw bad_alloc();
+        region.used += _chunk_bytes;
+        return chunk;
+    }
+
+    Chunk* add_chunk() {
+        Chunk* chunk;
+        if (!_empty.empty()) {
+            chunk = _empty.back();
+            _empty.pop_back();
+            *chunk = Chunk{nullptr, nullptr, chunk->owned};
+        }
+        else {
+            void* memory = _backing == Backing::mapped ? commit() : ::operator new(_chunk_bytes, align_val_t(_chunk_bytes));
+            chunk = new (memory) Chunk{};
+            if (_backing == Backing::heap) {
+                chunk->owned = _owned;
+                _owned = chunk;
+            }
+        }
+        link_partial(chunk);
+        ALLOCATOR_STAT(++_stats.chunks);
+        return chunk;
+    }
+
+    // An empty chunk goes back to the spare list, or starts over if it is the only one left,
+    // so the runs carved from its tail can be served again.
+    void release(Chunk* chunk) {
+        ALLOCATOR_STAT(_stats.free_slots -= chunk->carved);
+        if (!chunk->prev and !chunk->next) {
+            chunk->free = nullptr;
+            chunk->carved = 0;
+            return;
+        }
+        unlink_partial(chunk);
+        if (_backing == Backing::mapped)
+            madvise(chunk, _chunk_bytes, MADV_DONTNEED);
+        _empty.push_back(chunk);
+        ALLOCATOR_STAT(--_stats.chunks);
+    }
+
+public:
+    Pool(size_t size, size_t alignment, size_t block, Backing backing = Backing::heap):
+        _slot_size(round_up(max(size, sizeof(void*)), max(alignment, alignof(void*)))),
+        _alignment(max(alignment, alignof(void*))), _block(block), _backing(backing) {
+        _header = round_up(sizeof(Chunk), _alignment);
+        _chunk_bytes = bit_ceil(max(_header + _block * _slot_size, backing == Backing::mapped ? page : size_t(1)));
+        _capacity = (_chunk_bytes - _header) / _slot_size;
+    }
+
+    Pool(const Pool&) = delete;
+    Pool& operator =(const Pool&) = delete;
+
+    ~Pool() {
+        while (_owned) {
+            Chunk* next = _owned->owned;
+            ::operator delete(_owned, align_val_t(_chunk_bytes));
+            _owned = next;
+        }
+        for (Region& region: _regions)
+            munmap(region.base, region.size);
+    }
+
+    bool serves(size_t size, size_t alignment, size_t block, Backing backing) const {
+        alignment = max(alignment, alignof(void*));
+        return _slot_size == round_up(max(size, sizeof(void*)), alignment) and _alignment == alignment
+            and _block == block and _backing == backing;
+    }
+
+    size_t max_size() const {
+        return numeric_limits<size_t>::max() / _slot_size;
+    }
+
+#ifdef ALLOCATOR_STATS
+    const AllocatorStats& stats() const {
+        return _stats;
+    }
+
+    // Prints the stats to os after every period allocations, a null os stops the dumps.
+    void dump_every(ostream* os, size_t period) {
+        _dump = os;
+        _dump_period = period;
+    }
+#endif
+
+    // Runs longer than a chunk bypass the pool.
+    void* allocate(size_t num) {
+        if (num == 0 or num > max_size()) {
+            ALLOCATOR_STAT(++_stats.failed);
+            throw bad_alloc();
+        }
+#ifdef ALLOCATOR_STATS
+        ++_stats.allocations;
+        _stats.peak = max(_stats.peak, _stats.live += num);
+        if (_dump and _dump_period and _stats.allocations % _dump_period == 0)
+            *_dump << _stats;
+#endif
+        if (num > _capacity)
+            return ::operator new(num * _slot_size, align_val_t(_alignment));
+        Chunk* chunk = _partial;
+        void* result;
+        if (num == 1 and chunk and chunk->free) {
+            result = chunk->free;
+            chunk->free = *static_cast<void**>(result);
+            ALLOCATOR_STAT(--_stats.free_slots);
+        }
+        else {
+            if (!chunk or chunk->carved + num > _capacity) {
+#ifdef ALLOCATOR_STATS
+                try {
+                    chunk = add_chunk();
+                }
+                catch (const bad_alloc&) {
+                    ++_stats.failed;
+                    --_stats.allocations;
+                    _stats.live -= num;
+                    throw;
+                }
+#else
+                chunk = add_chunk();
+#endif
+            }
+            result = slot(chunk, chunk->carved);
+            chunk->carved += num;
+        }
+        chunk->live += num;
+        if (!chunk->free and chunk->carved == _capacity)
+            unlink_partial(chunk);
+        return result;
+    }
+
+    void deallocate(void* p, size_t num) {
+        ALLOCATOR_STAT(++_stats.deallocations);
+        ALLOCATOR_STAT(_stats.live -= num);
+        if (num > _capacity) {
+            ::operator delete(p, align_val_t(_alignment));
+            return;
+        }
+        Chunk* chunk = chunk_of(p);
+        for (size_t i = 0; i < num; ++i) {
+            void* freed = static_cast<unsigned char*>(p) + i * _slot_size;
+            *static_cast<void**>(freed) = chunk->free;
+            chunk->free = freed;
+        }
+        chunk->live -= num;
+        ALLOCATOR_STAT(_stats.free_slots += num);
+        if (!chunk->partial)
+            link_partial(chunk);
+        if (chunk->live == 0)
+            release(chunk);
+    }
+};
+
+// Set of pools, one per slot size and alignment, shared by an allocator and all its copies
+// and rebinds. It lives as long as the last allocator referring to it.
+class Arena {
+    vector<unique_ptr<Pool>> _pools;
+    Backing _backing;
+
+public:
+    explicit Arena(Backing backing = Backing::heap): _backing(backing) {}
+
+    Pool* pool(size_t size, size_t alignment, size_t block) {
+        for (auto& p: _pools)
+            if (p->serves(size, alignment, block, _backing))
+                return p.get();
+        _pools.push_back(make_unique<Pool>(size, alignment, block, _backing));
+        return _pools.back().get();
+    }
+
+#ifdef ALLOCATOR_STATS
+    // Totals over all pools, peak is the sum of the per-pool peaks.
+    AllocatorStats stats() const {
+        AllocatorStats result;
+        for (auto& p: _pools)
+            result += p->stats();
+        return result;
+    }
+#endif
+};
+
 template<class T, size_t BLOCK_SIZE>
 class Allocator {
-    T* _memory;
-    size_t _memory_size;
+    shared_ptr<Arena> _arena;
+    Pool* _pool;
+
+    template<class, size_t> friend class Allocator;
 
 public:
     static_assert(BLOCK_SIZE > 0);
@@ -19,6 +356,10 @@ public:
     using const_reference = const T&;
     using size_type = size_t;
     using difference_type = ptrdiff_t;
+    using propagate_on_container_copy_assignment = true_type;
+    using propagate_on_container_move_assignment = true_type;
+    using propagate_on_container_swap = true_type;
+    using is_always_equal = false_type;
 
     template<class U> 
     struct rebind { 
@@ -29,18 +370,322 @@ public:
         return &value; 
     }
 
-    Allocator(): _memory(reinterpret_cast<T*>(::operator new(BLOCK_SIZE * sizeof(T)))), _memory_size(0) {}
-    
-    ~Allocator() {
-        delete[] _memory;
+    Allocator(): Allocator(Backing::heap) {}
+
+    explicit Allocator(Backing backing):
+        _arena(make_shared<Arena>(backing)), _pool(_arena->pool(sizeof(T), alignof(T), BLOCK_SIZE)) {}
+
+    // Copies share the arena. There is no separate move, so a moved-from allocator stays usable.
+    Allocator(const Allocator&) = default;
+    Allocator& operator =(const Allocator&) = default;
+
+    template<class U>
+    Allocator(const Allocator<U, BLOCK_SIZE>& other): _arena(other._arena), _pool(_arena->pool(sizeof(T), alignof(T), BLOCK_SIZE)) {}
+
+    pointer allocate(size_type num, const void* hint = 0) {
+        return static_cast<pointer>(_pool->allocate(num));
+    }
+
+    void construct(pointer p, const value_type& value) {
+        new ((void*)p) value_type(value);
+    }
+
+    void destroy(pointer p) {
+        p->~value_type();
+    }
+
+    void deallocate(pointer p, size_type num) {
+        _pool->deallocate(p, num);
+    }
+
+    size_type max_size() const {
+        return _pool->max_size();
+    }
+
+#ifdef ALLOCATOR_STATS
+    const AllocatorStats& stats() const {
+        return _pool->stats();
+    }
+
+    AllocatorStats arena_stats() const {
+        return _arena->stats();
+    }
+
+    void dump_every(ostream* os, size_t period) {
+        _pool->dump_every(os, period);
+    }
+#endif
+
+    template<class U>
+    bool operator ==(const Allocator<U, BLOCK_SIZE>& other) const {
+        return _arena == other._arena;
+    }
+};
+
+// memory_resource over an Arena: requests are rounded up to a power of two and served by the
+// pool of that size, requests above max_pooled go straight to operator new.
+class PoolResource: public pmr::memory_resource {
+    static constexpr size_t max_pooled = 4096;
+    static constexpr size_t classes = bit_width(max_pooled);
+
+    shared_ptr<Arena> _arena;
+    size_t _block;
+    Pool* _pools[classes] = {};
+
+    Pool* pool(size_t bytes, size_t alignment) {
+        size_t size = bit_ceil(max(bytes, sizeof(void*)));
+        if (alignment > alignof(max_align_t))
+            return _arena->pool(size, alignment, _block);
+        Pool*& cached = _pools[bit_width(size) - 1];
+        if (!cached)
+            cached = _arena->pool(size, alignof(max_align_t), _block);
+        return cached;
+    }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        if (bytes > max_pooled)
+            return ::operator new(bytes, align_val_t(alignment));
+        return pool(bytes, alignment)->allocate(1);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        if (bytes > max_pooled)
+            ::operator delete(p, align_val_t(alignment));
+        else
+            pool(bytes, alignment)->deallocate(p, 1);
+    }
+
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    explicit PoolResource(size_t block = 64, Backing backing = Backing::heap): _arena(make_shared<Arena>(backing)), _block(block) {}
+};
+
+// memory_resource that only bumps a pointer through its chunks and never frees single
+// allocations. reset() releases everything at once by rewinding to the first chunk, the
+// chunks themselves are kept for the next round.
+class MonotonicArena: public pmr::memory_resource {
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+    };
+
+    Chunk* _first = nullptr;
+    Chunk* _current = nullptr;
+    size_t _used = 0;
+    size_t _next_size;
+
+    static constexpr size_t header = (sizeof(Chunk) + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+
+    unsigned char* base(Chunk* chunk) const {
+        return reinterpret_cast<unsigned char*>(chunk) + header;
     }
 
+    Chunk* make_chunk(size_t size) {
+        void* memory = ::operator new(header + size, align_val_t(alignof(max_align_t)));
+        return new (memory) Chunk{nullptr, size};
+    }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        while (true) {
+            if (_current) {
+                uintptr_t start = reinterpret_cast<uintptr_t>(base(_current)) + _used;
+                size_t padding = (alignment - start % alignment) % alignment;
+                if (_used + padding + bytes <= _current->size) {
+                    _used += padding + bytes;
+                    return reinterpret_cast<void*>(start + padding);
+                }
+            }
+            Chunk*& next = _current ? _current->next : _first;
+            if (!next or next->size < bytes + alignment) {
+                Chunk* chunk = make_chunk(max(_next_size, bytes + alignment));
+                _next_size *= 2;
+                chunk->next = next;
+                next = chunk;
+            }
+            _current = next;
+            _used = 0;
+        }
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    explicit MonotonicArena(size_t initial = 4096): _next_size(initial) {}
+
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator =(const MonotonicArena&) = delete;
+
+    ~MonotonicArena() {
+        while (_first) {
+            Chunk* next = _first->next;
+            ::operator delete(_first, align_val_t(alignof(max_align_t)));
+            _first = next;
+        }
+    }
+
+    void reset() {
+        _current = nullptr;
+        _used = 0;
+    }
+};
+
+// polymorphic_allocator with the Alloc<T, BLOCK_SIZE> shape that List expects.
+template<class T, size_t BLOCK_SIZE>
+class PmrAllocator: public pmr::polymorphic_allocator<T> {
+public:
+    using pmr::polymorphic_allocator<T>::polymorphic_allocator;
+
+    template<class U>
+    struct rebind {
+        using other = PmrAllocator<U, BLOCK_SIZE>;
+    };
+
+    template<class U>
+    PmrAllocator(const PmrAllocator<U, BLOCK_SIZE>& other): pmr::polymorphic_allocator<T>(other.resource()) {}
+};
+
+// Stateless pool that can be shared between threads. Every thread allocates from its own cache
+// of free slots, surplus slots go back in batches to a global depot (a Treiber stack with a
+// tagged top pointer) and an empty cache takes a batch from there or carves a new chunk.
+template<class T, size_t BLOCK_SIZE>
+class ConcurrentAllocator {
+    static_assert(sizeof(void*) == 8, "tagged pointers need 64-bit addresses with 16 spare bits");
+
+    union Slot {
+        struct {
+            Slot* next;
+            Slot* batch;
+        } link;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    struct alignas(Slot) Chunk {
+        Chunk* next;
+    };
+
+    class Depot {
+        atomic<uint64_t> top{0};
+        atomic<Chunk*> chunks{nullptr};
+
+        static constexpr uint64_t mask = (uint64_t(1) << 48) - 1;
+
+        static Slot* pointer(uint64_t tagged) {
+            return reinterpret_cast<Slot*>(tagged & mask);
+        }
+
+        static uint64_t retag(Slot* slot, uint64_t old) {
+            return reinterpret_cast<uint64_t>(slot) | ((old & ~mask) + (mask + 1));
+        }
+
+    public:
+        ~Depot() {
+            for (Chunk* chunk = chunks.load(); chunk;) {
+                Chunk* next = chunk->next;
+                ::operator delete(chunk, align_val_t(alignof(Chunk)));
+                chunk = next;
+            }
+        }
+
+        void push(Slot* batch) {
+            uint64_t old = top.load(memory_order_relaxed);
+            do
+                batch->link.batch = pointer(old);
+            while (!top.compare_exchange_weak(old, retag(batch, old), memory_order_release, memory_order_relaxed));
+        }
+
+        Slot* pop() {
+            uint64_t old = top.load(memory_order_acquire);
+            Slot* batch;
+            do {
+                batch = pointer(old);
+                if (!batch)
+                    return nullptr;
+            } while (!top.compare_exchange_weak(old, retag(batch->link.batch, old), memory_order_acquire, memory_order_acquire));
+            return batch;
+        }
+
+        Slot* carve() {
+            void* memory = ::operator new(sizeof(Chunk) + BLOCK_SIZE * sizeof(Slot), align_val_t(alignof(Chunk)));
+            Chunk* chunk = new (memory) Chunk{chunks.load(memory_order_relaxed)};
+            while (!chunks.compare_exchange_weak(chunk->next, chunk, memory_order_release, memory_order_relaxed));
+            Slot* slots = reinterpret_cast<Slot*>(chunk + 1);
+            for (size_t i = 0; i + 1 < BLOCK_SIZE; ++i)
+                slots[i].link.next = &slots[i + 1];
+            slots[BLOCK_SIZE - 1].link.next = nullptr;
+            return slots;
+        }
+    };
+
+    struct Cache {
+        Slot* free = nullptr;
+        size_t count = 0;
+
+        ~Cache() {
+            if (free)
+                depot().push(free);
+        }
+    };
+
+    static Depot& depot() {
+        static Depot instance;
+        return instance;
+    }
+
+    static Cache& cache() {
+        thread_local Cache instance;
+        return instance;
+    }
+
+public:
+    static_assert(BLOCK_SIZE > 0);
+    using value_type = T;
+    using pointer = T*;
+    using const_pointer = const T*;
+    using reference = T&;
+    using const_reference = const T&;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using is_always_equal = true_type;
+
+    template<class U>
+    struct rebind {
+        using other = ConcurrentAllocator<U, BLOCK_SIZE>;
+    };
+
+    pointer address(reference value) const {
+        return &value;
+    }
+
+    ConcurrentAllocator() = default;
+
+    template<class U>
+    ConcurrentAllocator(const ConcurrentAllocator<U, BLOCK_SIZE>&) {}
+
     pointer allocate(size_type num, const void* hint = 0) {
-        if(_memory_size + num > BLOCK_SIZE)
-            throw bad_alloc();
-        pointer result = &_memory[_memory_size];
-        _memory_size += num;
-        return result;
+        if (num != 1)
+            return static_cast<pointer>(::operator new(num * sizeof(T), align_val_t(alignof(T))));
+        Cache& local = cache();
+        if (!local.free) {
+            Depot& global = depot();
+            local.free = global.pop();
+            if (!local.free)
+                local.free = global.carve();
+            for (Slot* slot = local.free; slot; slot = slot->link.next)
+                ++local.count;
+        }
+        Slot* slot = local.free;
+        local.free = slot->link.next;
+        --local.count;
+        return reinterpret_cast<pointer>(slot);
     }
 
     void construct(pointer p, const value_type& value) {
@@ -52,11 +697,33 @@ public:
     }
 
     void deallocate(pointer p, size_type num) {
-        //?
+        if (num != 1) {
+            ::operator delete(p, align_val_t(alignof(T)));
+            return;
+        }
+        Cache& local = cache();
+        Slot* slot = reinterpret_cast<Slot*>(p);
+        slot->link.next = local.free;
+        local.free = slot;
+        if (++local.count < 2 * BLOCK_SIZE)
+            return;
+        Slot* last = local.free;
+        for (size_t i = 1; i < BLOCK_SIZE; ++i)
+            last = last->link.next;
+        Slot* batch = local.free;
+        local.free = last->link.next;
+        last->link.next = nullptr;
+        local.count -= BLOCK_SIZE;
+        depot().push(batch);
     }
 
     size_type max_size() const {
-        return BLOCK_SIZE;
+        return numeric_limits<size_type>::max() / sizeof(T);
+    }
+
+    template<class U>
+    bool operator ==(const ConcurrentAllocator<U, BLOCK_SIZE>&) const {
+        return true;
     }
 };
 
@@ -74,6 +741,8 @@ template<Node T>
 class Iterator {
     T* ptr;
 
+    template<typename, size_t, template<class, size_t> class> friend class List;
+
 public:
     using value_type = typename T::value_type;
     using pointer = value_type*;
@@ -131,12 +800,66 @@ class List {
         Node* next;
 
         Node(const T& v, Node* n): value(v), next(n) {}
+
+        template<class... Args>
+        Node(Node* n, Args&&... args): value(forward<Args>(args)...), next(n) {}
     };
 
     using NodeAllocator = Alloc<Node, BLOCK_SIZE>;
+    using Traits = allocator_traits<NodeAllocator>;
 
     NodeAllocator allocator;
     Node* head;
+    Node* tail = nullptr;
+    size_t count = 0;
+
+    template<class... Args>
+    Node* make_node(Node* next, Args&&... args) {
+        Node* node = Traits::allocate(allocator, 1);
+        try {
+            Traits::construct(allocator, node, next, forward<Args>(args)...);
+        }
+        catch (...) {
+            Traits::deallocate(allocator, node, 1);
+            throw;
+        }
+        ++count;
+        return node;
+    }
+
+    void free_node(Node* node) {
+        Traits::destroy(allocator, node);
+        Traits::deallocate(allocator, node, 1);
+        --count;
+    }
+
+    // Cuts the chain after n nodes and returns the rest.
+    static Node* split(Node* node, size_t n) {
+        for (size_t i = 1; node and i < n; ++i)
+            node = node->next;
+        if (!node)
+            return nullptr;
+        Node* rest = node->next;
+        node->next = nullptr;
+        return rest;
+    }
+
+    // Stable merge of two sorted chains, last is set to the final node.
+    template<class Compare>
+    static Node* merge_chains(Node* a, Node* b, Compare& less, Node*& last) {
+        Node* result = nullptr;
+        Node** link = &result;
+        while (a and b) {
+            Node*& taken = less(b->value, a->value) ? b : a;
+            *link = taken;
+            taken = taken->next;
+            link = &(*link)->next;
+        }
+        *link = a ? a : b;
+        for (; *link; link = &(*link)->next)
+            last = *link;
+        return result;
+    }
 
 public:
     using NodeType = Node;
@@ -146,38 +869,184 @@ public:
 
     List(): head(nullptr) {}
 
+    template<class A> requires constructible_from<NodeAllocator, const A&>
+    explicit List(const A& a): allocator(a), head(nullptr) {}
+
     ~List() {
         while(head) {
             Node* temp = head;
             head = head->next;
-            allocator.destroy(temp);
-            //allocator.deallocate(temp, 1);
+            free_node(temp);
         }
     }
 
+    template<class... Args>
+    T& emplace_front(Args&&... args) {
+        head = make_node(head, forward<Args>(args)...);
+        if (!tail)
+            tail = head;
+        return head->value;
+    }
+
+    template<class... Args>
+    T& emplace_back(Args&&... args) {
+        Node* node = make_node(nullptr, forward<Args>(args)...);
+        if (tail)
+            tail->next = node;
+        else
+            head = node;
+        tail = node;
+        return node->value;
+    }
+
     void push_front(const T& value) {
-        Node* new_node = allocator.allocate(1);
-        allocator.construct(new_node, Node(value, head));
-        head = new_node;
+        emplace_front(value);
+    }
+
+    void push_back(const T& value) {
+        emplace_back(value);
     }
 
     void pop_front() {
         if (head) {
             Node* old_head = head;
             head = head->next;
-            allocator.destroy(old_head);
-            allocator.deallocate(old_head, 1);
+            if (!head)
+                tail = nullptr;
+            free_node(old_head);
         }
     }
 
+    // Inserts after the element at pos and returns an iterator to the new element.
+    iterator insert_after(iterator pos, const T& value) {
+        if (!pos.ptr)
+            throw invalid_argument("INVALID_ITERATOR");
+        pos.ptr->next = make_node(pos.ptr->next, value);
+        if (tail == pos.ptr)
+            tail = pos.ptr->next;
+        return iterator(pos.ptr->next);
+    }
+
+    // Removes the element following pos and returns an iterator to the one after it.
+    iterator erase_after(iterator pos) {
+        if (!pos.ptr or !pos.ptr->next)
+            throw invalid_argument("INVALID_ITERATOR");
+        Node* victim = pos.ptr->next;
+        pos.ptr->next = victim->next;
+        if (tail == victim)
+            tail = pos.ptr;
+        free_node(victim);
+        return iterator(pos.ptr->next);
+    }
+
+    // Moves all elements of other after pos without copying. The nodes are released by this
+    // list later, so both lists must use equal allocators.
+    void splice_after(iterator pos, List& other) {
+        if (!pos.ptr or !(allocator == other.allocator))
+            throw invalid_argument("INVALID_SPLICE");
+        if (!other.head or &other == this)
+            return;
+        other.tail->next = pos.ptr->next;
+        pos.ptr->next = other.head;
+        if (tail == pos.ptr)
+            tail = other.tail;
+        count += other.count;
+        other.head = other.tail = nullptr;
+        other.count = 0;
+    }
+
+    void splice_front(List& other) {
+        if (!(allocator == other.allocator))
+            throw invalid_argument("INVALID_SPLICE");
+        if (!other.head or &other == this)
+            return;
+        other.tail->next = head;
+        head = other.head;
+        if (!tail)
+            tail = other.tail;
+        count += other.count;
+        other.head = other.tail = nullptr;
+        other.count = 0;
+    }
+
+    // Bottom-up merge sort by relinking nodes: O(n log n) time, no allocation, O(1) extra space.
+    template<class Compare = less<T>>
+    void sort(Compare less = Compare()) {
+        for (size_t width = 1; width < count; width *= 2) {
+            Node* rest = head;
+            Node* sorted = nullptr;
+            Node** link = &sorted;
+            while (rest) {
+                Node* left = rest;
+                Node* right = split(left, width);
+                rest = split(right, width);
+                *link = merge_chains(left, right, less, tail);
+                link = &tail->next;
+            }
+            head = sorted;
+        }
+    }
+
+    // Moves the nodes of other, both sorted by less, into this list keeping it sorted.
+    template<class Compare = less<T>>
+    void merge(List& other, Compare less = Compare()) {
+        if (!(allocator == other.allocator))
+            throw invalid_argument("INVALID_SPLICE");
+        if (&other == this or !other.head)
+            return;
+        head = merge_chains(head, other.head, less, tail);
+        count += other.count;
+        other.head = other.tail = nullptr;
+        other.count = 0;
+    }
+
+    // Drops every element equal to the one before it, returns the number removed.
+    template<class BinaryPredicate = equal_to<T>>
+    size_t unique(BinaryPredicate equal = BinaryPredicate()) {
+        size_t before = count;
+        for (Node* node = head; node and node->next;) {
+            if (equal(node->value, node->next->value)) {
+                Node* victim = node->next;
+                node->next = victim->next;
+                free_node(victim);
+            }
+            else
+                node = node->next;
+        }
+        for (tail = head; tail and tail->next; tail = tail->next);
+        return before - count;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
     T& front() {
-        if(head)
-            return head->value;
+        if (!head)
+            throw invalid_argument("EMPTY_LIST");
+        return head->value;
     }
 
     const T& front() const {
-        if(head)
-            return head->value;
+        if (!head)
+            throw invalid_argument("EMPTY_LIST");
+        return head->value;
+    }
+
+    T& back() {
+        if (!tail)
+            throw invalid_argument("EMPTY_LIST");
+        return tail->value;
+    }
+
+    const T& back() const {
+        if (!tail)
+            throw invalid_argument("EMPTY_LIST");
+        return tail->value;
     }
 
     iterator begin() {
@@ -188,7 +1057,7 @@ public:
         return iterator(nullptr);
     }
 
-    *const_iterator cbegin() const {
+    const_iterator cbegin() const {
         return const_iterator(head);
     }
 
@@ -197,6 +1066,815 @@ public:
     }
 };
 
+template<typename T>
+concept UnrolledNode = requires(T node, size_t i) {
+    { node.element(i) } -> convertible_to<typename T::value_type&>;
+    { node.first } -> convertible_to<size_t>;
+    { node.last } -> convertible_to<size_t>;
+    { node.next } -> convertible_to<T*>;
+};
+
+template<UnrolledNode T>
+class UnrolledIterator {
+    T* ptr;
+    size_t index;
+
+public:
+    using value_type = typename T::value_type;
+    using pointer = value_type*;
+    using reference = value_type&;
+    using difference_type = ptrdiff_t;
+    using iterator_category = forward_iterator_tag;
+
+    UnrolledIterator(T* p = nullptr): ptr(p), index(p ? p->first : 0) {}
+
+    reference operator *() const {
+        return ptr->element(index);
+    }
+
+    pointer operator ->() const {
+        return &ptr->element(index);
+    }
+
+    UnrolledIterator& operator ++() {
+        if (++index == ptr->last) {
+            ptr = ptr->next;
+            index = ptr ? ptr->first : 0;
+        }
+        return *this;
+    }
+
+    UnrolledIterator operator ++(int) {
+        UnrolledIterator tmp(*this);
+        operator ++();
+        return tmp;
+    }
+
+    bool operator ==(const UnrolledIterator& other) const {
+        return ptr == other.ptr and index == other.index;
+    }
+
+    bool operator !=(const UnrolledIterator& other) const {
+        return !(*this == other);
+    }
+};
+
+// List whose nodes hold a run of elements and fill whole cache lines, so a scan touches
+// consecutive memory instead of chasing one pointer per element. The front node fills from
+// its end and the back node from its start, so both ends take inserts without shifting.
+template<typename T, size_t BLOCK_SIZE, template<class, size_t> class Alloc>
+class UnrolledList {
+    static constexpr size_t line = 64;
+    static constexpr size_t header = 2 * sizeof(void*);
+    static constexpr size_t lines = (header + 4 * sizeof(T) + line - 1) / line;
+
+public:
+    static constexpr size_t capacity = (lines * line - header) / sizeof(T);
+
+private:
+    struct alignas(line) Node {
+        using value_type = T;
+        Node* next = nullptr;
+        uint32_t first = 0, last = 0;
+        alignas(T) unsigned char storage[capacity * sizeof(T)];
+
+        T& element(size_t i) {
+            return reinterpret_cast<T*>(storage)[i];
+        }
+    };
+
+    using NodeAllocator = Alloc<Node, BLOCK_SIZE>;
+    using Traits = allocator_traits<NodeAllocator>;
+
+    NodeAllocator allocator;
+    Node* head = nullptr;
+    Node* tail = nullptr;
+    size_t count = 0;
+
+    Node* make_node(size_t start) {
+        Node* node = Traits::allocate(allocator, 1);
+        Traits::construct(allocator, node);
+        node->first = node->last = start;
+        return node;
+    }
+
+    void free_node(Node* node) {
+        Traits::destroy(allocator, node);
+        Traits::deallocate(allocator, node, 1);
+    }
+
+public:
+    using NodeType = Node;
+    using ValueType = T;
+    using iterator = UnrolledIterator<Node>;
+    using const_iterator = UnrolledIterator<Node>;
+
+    UnrolledList() = default;
+
+    template<class A> requires constructible_from<NodeAllocator, const A&>
+    explicit UnrolledList(const A& a): allocator(a) {}
+
+    UnrolledList(const UnrolledList&) = delete;
+    UnrolledList& operator =(const UnrolledList&) = delete;
+
+    ~UnrolledList() {
+        while (head) {
+            Node* node = head;
+            head = head->next;
+            for (size_t i = node->first; i < node->last; ++i)
+                destroy_at(&node->element(i));
+            free_node(node);
+        }
+    }
+
+    // A new node is linked only once the element is constructed in it, so a throwing
+    // constructor leaves the list unchanged.
+    template<class... Args>
+    T& emplace_front(Args&&... args) {
+        Node* node = head and head->first > 0 ? head : make_node(capacity);
+        T* result;
+        try {
+            result = construct_at(&node->element(node->first - 1), forward<Args>(args)...);
+        }
+        catch (...) {
+            if (node != head)
+                free_node(node);
+            throw;
+        }
+        if (node != head) {
+            node->next = head;
+            head = node;
+            if (!tail)
+                tail = node;
+        }
+        --head->first;
+        ++count;
+        return *result;
+    }
+
+    template<class... Args>
+    T& emplace_back(Args&&... args) {
+        Node* node = tail and tail->last < capacity ? tail : make_node(0);
+        T* result;
+        try {
+            result = construct_at(&node->element(node->last), forward<Args>(args)...);
+        }
+        catch (...) {
+            if (node != tail)
+                free_node(node);
+            throw;
+        }
+        if (node != tail) {
+            if (tail)
+                tail->next = node;
+            else
+                head = node;
+            tail = node;
+        }
+        ++tail->last;
+        ++count;
+        return *result;
+    }
+
+    void push_front(const T& value) {
+        emplace_front(value);
+    }
+
+    void push_back(const T& value) {
+        emplace_back(value);
+    }
+
+    void pop_front() {
+        if (!head)
+            return;
+        destroy_at(&head->element(head->first++));
+        --count;
+        if (head->first == head->last) {
+            Node* old_head = head;
+            head = head->next;
+            if (!head)
+                tail = nullptr;
+            free_node(old_head);
+        }
+    }
+
+    T& front() {
+        if (!head)
+            throw invalid_argument("EMPTY_LIST");
+        return head->element(head->first);
+    }
+
+    T& back() {
+        if (!tail)
+            throw invalid_argument("EMPTY_LIST");
+        return tail->element(tail->last - 1);
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    iterator begin() {
+        return iterator(head);
+    }
+
+    iterator end() {
+        return iterator(nullptr);
+    }
+
+    const_iterator cbegin() const {
+        return const_iterator(head);
+    }
+
+    const_iterator cend() const {
+        return const_iterator(nullptr);
+    }
+};
+
+// Links embedded in the user's object. An object derives from one hook per list it can belong
+// to, distinguished by Tag. Copies start unlinked, destruction unlinks.
+template<class Tag = void>
+class ListHook {
+    ListHook* prev = nullptr;
+    ListHook* next = nullptr;
+
+    template<class, class> friend class IntrusiveList;
+    template<class, class> friend class IntrusiveIterator;
+
+public:
+    ListHook() = default;
+
+    ListHook(const ListHook&) {}
+
+    ListHook& operator =(const ListHook&) {
+        return *this;
+    }
+
+    ~ListHook() {
+        unlink();
+    }
+
+    bool linked() const {
+        return next != nullptr;
+    }
+
+    void unlink() {
+        if (!next)
+            return;
+        prev->next = next;
+        next->prev = prev;
+        prev = next = nullptr;
+    }
+};
+
+template<class T, class Tag>
+class IntrusiveIterator {
+    using Hook = ListHook<Tag>;
+
+    Hook* ptr;
+
+    template<class, class> friend class IntrusiveList;
+    template<class, class> friend class IntrusiveIterator;
+
+public:
+    using value_type = remove_const_t<T>;
+    using pointer = T*;
+    using reference = T&;
+    using difference_type = ptrdiff_t;
+    using iterator_category = bidirectional_iterator_tag;
+
+    IntrusiveIterator(Hook* p = nullptr): ptr(p) {}
+
+    template<class U> requires is_same_v<const U, T>
+    IntrusiveIterator(const IntrusiveIterator<U, Tag>& other): ptr(other.ptr) {}
+
+    reference operator *() const {
+        return static_cast<T&>(*ptr);
+    }
+
+    pointer operator ->() const {
+        return &static_cast<T&>(*ptr);
+    }
+
+    IntrusiveIterator& operator ++() {
+        ptr = ptr->next;
+        return *this;
+    }
+
+    IntrusiveIterator operator ++(int) {
+        IntrusiveIterator tmp(ptr);
+        operator ++();
+        return tmp;
+    }
+
+    IntrusiveIterator& operator --() {
+        ptr = ptr->prev;
+        return *this;
+    }
+
+    IntrusiveIterator operator --(int) {
+        IntrusiveIterator tmp(ptr);
+        operator --();
+        return tmp;
+    }
+
+    bool operator ==(const IntrusiveIterator& other) const {
+        return ptr == other.ptr;
+    }
+
+    bool operator !=(const IntrusiveIterator& other) const {
+        return ptr != other.ptr;
+    }
+};
+
+// Circular doubly linked list over objects that derive from ListHook<Tag>. The list owns no
+// memory: it never allocates and never destroys its elements, it only links them. size() walks
+// the list, because a hook can unlink itself without the list knowing.
+template<class T, class Tag = void>
+class IntrusiveList {
+    using Hook = ListHook<Tag>;
+
+    Hook sentinel;
+
+    static Hook& hook(T& value) {
+        static_assert(is_base_of_v<Hook, T>, "T must derive from ListHook<Tag>");
+        return static_cast<Hook&>(value);
+    }
+
+    static void link_before(Hook* position, Hook& node) {
+        if (node.linked())
+            throw invalid_argument("ALREADY_LINKED");
+        node.prev = position->prev;
+        node.next = position;
+        position->prev->next = &node;
+        position->prev = &node;
+    }
+
+public:
+    using value_type = T;
+    using iterator = IntrusiveIterator<T, Tag>;
+    using const_iterator = IntrusiveIterator<const T, Tag>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    IntrusiveList() {
+        sentinel.prev = sentinel.next = &sentinel;
+    }
+
+    IntrusiveList(const IntrusiveList&) = delete;
+    IntrusiveList& operator =(const IntrusiveList&) = delete;
+
+    IntrusiveList(IntrusiveList&& other): IntrusiveList() {
+        splice(end(), other);
+    }
+
+    ~IntrusiveList() {
+        clear();
+    }
+
+    iterator begin() {
+        return iterator(sentinel.next);
+    }
+
+    iterator end() {
+        return iterator(&sentinel);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(sentinel.next);
+    }
+
+    const_iterator end() const {
+        return const_iterator(const_cast<Hook*>(&sentinel));
+    }
+
+    reverse_iterator rbegin() {
+        return reverse_iterator(end());
+    }
+
+    reverse_iterator rend() {
+        return reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rbegin() const {
+        return const_reverse_iterator(end());
+    }
+
+    const_reverse_iterator rend() const {
+        return const_reverse_iterator(begin());
+    }
+
+    // Iterator to an element known to be in this list.
+    static iterator iterator_to(T& value) {
+        if (!hook(value).linked())
+            throw invalid_argument("INVALID_ITERATOR");
+        return iterator(&hook(value));
+    }
+
+    bool empty() const {
+        return sentinel.next == &sentinel;
+    }
+
+    size_t size() const {
+        return distance(begin(), end());
+    }
+
+    T& front() {
+        if (empty())
+            throw invalid_argument("EMPTY_LIST");
+        return *begin();
+    }
+
+    T& back() {
+        if (empty())
+            throw invalid_argument("EMPTY_LIST");
+        return *prev(end());
+    }
+
+    void push_front(T& value) {
+        link_before(sentinel.next, hook(value));
+    }
+
+    void push_back(T& value) {
+        link_before(&sentinel, hook(value));
+    }
+
+    iterator insert(iterator position, T& value) {
+        link_before(position.ptr, hook(value));
+        return iterator(&hook(value));
+    }
+
+    void pop_front() {
+        front();
+        sentinel.next->unlink();
+    }
+
+    void pop_back() {
+        back();
+        sentinel.prev->unlink();
+    }
+
+    iterator erase(iterator position) {
+        if (position == end())
+            throw invalid_argument("INVALID_ITERATOR");
+        Hook* next = position.ptr->next;
+        position.ptr->unlink();
+        return iterator(next);
+    }
+
+    // O(1), the element's hook knows its neighbours.
+    static void unlink(T& value) {
+        hook(value).unlink();
+    }
+
+    // Moves all elements of other before position.
+    void splice(iterator position, IntrusiveList& other) {
+        if (&other == this or other.empty())
+            return;
+        Hook* first = other.sentinel.next;
+        Hook* last = other.sentinel.prev;
+        other.sentinel.prev = other.sentinel.next = &other.sentinel;
+        Hook* after = position.ptr;
+        first->prev = after->prev;
+        last->next = after;
+        after->prev->next = first;
+        after->prev = last;
+    }
+
+    void clear() {
+        while (!empty())
+            sentinel.next->unlink();
+    }
+};
+
+// Hazard pointers shared by the lock-free containers. A thread publishes the nodes it is about
+// to dereference, retired nodes are reclaimed only once no thread publishes them. Retired
+// nodes left behind by an exiting thread are adopted by the next scan of another thread.
+class HazardPointers {
+public:
+    static constexpr size_t max_threads = 128;
+    static constexpr size_t per_thread = 2;
+
+private:
+    struct Record {
+        atomic<bool> active{false};
+        atomic<void*> hazards[per_thread] = {};
+    };
+
+    struct Retired {
+        void* pointer;
+        void (*reclaim)(void*);
+    };
+
+    struct Local {
+        Record* record = nullptr;
+        vector<Retired> retired;
+
+        ~Local() {
+            if (!record)
+                return;
+            HazardPointers& domain = instance();
+            for (auto& hazard: record->hazards)
+                hazard.store(nullptr, memory_order_release);
+            record->active.store(false, memory_order_release);
+            lock_guard<mutex> lock(domain.orphans_mutex);
+            domain.orphans.insert(domain.orphans.end(), retired.begin(), retired.end());
+        }
+    };
+
+    Record records[max_threads];
+    mutex orphans_mutex;
+    vector<Retired> orphans;
+
+    Record& record() {
+        Local& local = this->local();
+        if (!local.record) {
+            for (Record& r: records) {
+                bool expected = false;
+                if (r.active.compare_exchange_strong(expected, true)) {
+                    local.record = &r;
+                    break;
+                }
+            }
+            if (!local.record)
+                throw runtime_error("TOO_MANY_THREADS");
+        }
+        return *local.record;
+    }
+
+    static Local& local() {
+        thread_local Local instance;
+        return instance;
+    }
+
+    void scan() {
+        vector<Retired>& retired = local().retired;
+        {
+            unique_lock<mutex> lock(orphans_mutex, try_to_lock);
+            if (lock.owns_lock()) {
+                retired.insert(retired.end(), orphans.begin(), orphans.end());
+                orphans.clear();
+            }
+        }
+        vector<void*> published;
+        for (Record& r: records)
+            for (auto& hazard: r.hazards)
+                if (void* p = hazard.load(memory_order_seq_cst))
+                    published.push_back(p);
+        sort(published.begin(), published.end());
+        size_t kept = 0;
+        for (Retired& node: retired) {
+            if (binary_search(published.begin(), published.end(), node.pointer))
+                retired[kept++] = node;
+            else
+                node.reclaim(node.pointer);
+        }
+        retired.resize(kept);
+    }
+
+public:
+    static HazardPointers& instance() {
+        static HazardPointers domain;
+        return domain;
+    }
+
+    // Publishes the current value of source in hazard slot k and returns it once it is stable.
+    template<class N>
+    N* protect(size_t k, const atomic<N*>& source) {
+        atomic<void*>& hazard = record().hazards[k];
+        N* p = source.load(memory_order_relaxed);
+        while (true) {
+            hazard.store(p, memory_order_seq_cst);
+            N* current = source.load(memory_order_seq_cst);
+            if (current == p)
+                return p;
+            p = current;
+        }
+    }
+
+    void clear(size_t k) {
+        record().hazards[k].store(nullptr, memory_order_release);
+    }
+
+    void retire(void* p, void (*reclaim)(void*)) {
+        vector<Retired>& retired = local().retired;
+        retired.push_back({p, reclaim});
+        if (retired.size() >= 2 * max_threads * per_thread)
+            scan();
+    }
+};
+
+// Treiber stack. Nodes come from a stateless thread-safe allocator so that retired nodes can be
+// reclaimed by whichever thread scans them.
+template<typename T, size_t BLOCK_SIZE, template<class, size_t> class Alloc = ConcurrentAllocator>
+class LockFreeStack {
+    struct Node {
+        Node* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T& value() {
+            return *reinterpret_cast<T*>(storage);
+        }
+    };
+
+    using NodeAllocator = Alloc<Node, BLOCK_SIZE>;
+    static_assert(allocator_traits<NodeAllocator>::is_always_equal::value);
+
+    atomic<Node*> top{nullptr};
+
+    static void reclaim(void* p) {
+        NodeAllocator().deallocate(static_cast<Node*>(p), 1);
+    }
+
+public:
+    LockFreeStack() = default;
+    LockFreeStack(const LockFreeStack&) = delete;
+    LockFreeStack& operator =(const LockFreeStack&) = delete;
+
+    ~LockFreeStack() {
+        for (Node* node = top.load(); node;) {
+            Node* next = node->next;
+            destroy_at(&node->value());
+            reclaim(node);
+            node = next;
+        }
+    }
+
+    // False when no memory could be allocated for the element.
+    template<class... Args>
+    bool try_emplace(Args&&... args) {
+        Node* node;
+        try {
+            node = NodeAllocator().allocate(1);
+        }
+        catch (const bad_alloc&) {
+            return false;
+        }
+        try {
+            construct_at(&node->value(), forward<Args>(args)...);
+        }
+        catch (...) {
+            reclaim(node);
+            throw;
+        }
+        node->next = top.load(memory_order_relaxed);
+        while (!top.compare_exchange_weak(node->next, node, memory_order_release, memory_order_relaxed));
+        return true;
+    }
+
+    bool try_push(const T& value) {
+        return try_emplace(value);
+    }
+
+    // False when the stack is empty.
+    bool try_pop(T& out) {
+        HazardPointers& hazards = HazardPointers::instance();
+        Node* node;
+        while (true) {
+            node = hazards.protect(0, top);
+            if (!node) {
+                hazards.clear(0);
+                return false;
+            }
+            if (top.compare_exchange_strong(node, node->next, memory_order_acquire, memory_order_relaxed))
+                break;
+        }
+        hazards.clear(0);
+        out = move(node->value());
+        destroy_at(&node->value());
+        hazards.retire(node, reclaim);
+        return true;
+    }
+
+    bool empty() const {
+        return top.load(memory_order_acquire) == nullptr;
+    }
+};
+
+// Michael-Scott queue with a dummy head node, reclaimed through the same hazard pointers.
+template<typename T, size_t BLOCK_SIZE, template<class, size_t> class Alloc = ConcurrentAllocator>
+class LockFreeQueue {
+    struct Node {
+        atomic<Node*> next{nullptr};
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T& value() {
+            return *reinterpret_cast<T*>(storage);
+        }
+    };
+
+    using NodeAllocator = Alloc<Node, BLOCK_SIZE>;
+    static_assert(allocator_traits<NodeAllocator>::is_always_equal::value);
+
+    atomic<Node*> head, tail;
+
+    static Node* make_node() {
+        return construct_at(NodeAllocator().allocate(1));
+    }
+
+    static void reclaim(void* p) {
+        Node* node = static_cast<Node*>(p);
+        destroy_at(node);
+        NodeAllocator().deallocate(node, 1);
+    }
+
+public:
+    LockFreeQueue() {
+        Node* dummy = make_node();
+        head.store(dummy);
+        tail.store(dummy);
+    }
+
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator =(const LockFreeQueue&) = delete;
+
+    ~LockFreeQueue() {
+        Node* node = head.load();
+        for (Node* next = node->next.load(); next; next = node->next.load()) {
+            destroy_at(&next->value());
+            reclaim(node);
+            node = next;
+        }
+        reclaim(node);
+    }
+
+    // False when no memory could be allocated for the element.
+    template<class... Args>
+    bool try_emplace(Args&&... args) {
+        Node* node;
+        try {
+            node = make_node();
+        }
+        catch (const bad_alloc&) {
+            return false;
+        }
+        try {
+            construct_at(&node->value(), forward<Args>(args)...);
+        }
+        catch (...) {
+            reclaim(node);
+            throw;
+        }
+        HazardPointers& hazards = HazardPointers::instance();
+        while (true) {
+            Node* last = hazards.protect(0, tail);
+            Node* next = last->next.load(memory_order_acquire);
+            if (last != tail.load(memory_order_acquire))
+                continue;
+            if (next) {
+                tail.compare_exchange_strong(last, next, memory_order_release, memory_order_relaxed);
+                continue;
+            }
+            if (last->next.compare_exchange_weak(next, node, memory_order_release, memory_order_relaxed)) {
+                tail.compare_exchange_strong(last, node, memory_order_release, memory_order_relaxed);
+                break;
+            }
+        }
+        hazards.clear(0);
+        return true;
+    }
+
+    bool try_push(const T& value) {
+        return try_emplace(value);
+    }
+
+    // False when the queue is empty.
+    bool try_pop(T& out) {
+        HazardPointers& hazards = HazardPointers::instance();
+        while (true) {
+            Node* first = hazards.protect(0, head);
+            Node* last = tail.load(memory_order_acquire);
+            Node* next = hazards.protect(1, first->next);
+            if (first != head.load(memory_order_acquire))
+                continue;
+            if (!next) {
+                hazards.clear(0);
+                hazards.clear(1);
+                return false;
+            }
+            if (first == last) {
+                tail.compare_exchange_strong(last, next, memory_order_release, memory_order_relaxed);
+                continue;
+            }
+            if (head.compare_exchange_strong(first, next, memory_order_acq_rel, memory_order_relaxed)) {
+                out = move(next->value());
+                destroy_at(&next->value());
+                hazards.clear(0);
+                hazards.clear(1);
+                hazards.retire(first, reclaim);
+                return true;
+            }
+        }
+    }
+
+    bool empty() const {
+        return head.load(memory_order_acquire)->next.load(memory_order_acquire) == nullptr;
+    }
+};
 
 int main() {
     map<int, int, less<int>, Allocator<pair<const int, int>, 10>> m;
@@ -12,6 +12,11 @@
 #include <atomic>
 #include <chrono>
 #include <random>
+#include <cstdint>
+#include <unordered_map>
+#include <deque>
+#include <functional>
+#include <condition_variable>
 
 using namespace std;
 
@@ -79,15 +84,53 @@ public:
     virtual void visit(Pegasus& pegasus) = 0;
 };
 
+class npc;
+class board;
+
+// Columns of the pieces on a board, one row per piece in board order. The movement and combat
+// systems scan these directly. An npc on a board is a facade over its row.
+class npc_store {
+public:
+    vector<int> x, y;
+    vector<npc_type> type;
+    vector<npc_status> status;
+    vector<uint32_t> name_id;
+    vector<npc*> owners;
+
+    size_t size() const { return owners.size(); }
+    const string& name_of(size_t slot) const { return names[name_id[slot]]; }
+
+    void add(npc& piece);
+    // Hands the row back to the piece and marks it for compact().
+    void release(npc& piece);
+    // Drops released rows, keeping the order of the others.
+    void compact();
+
+private:
+    // Indexed by name id. Ids of released rows are reused, so the table never outgrows the
+    // largest number of pieces the board has held at once.
+    vector<string> names;
+    vector<uint32_t> free_names;
+};
+
 class npc {
 protected:
     int x, y;
     string name;
     npc_type type;
     npc_status status = npc_status::alive;
+    npc_store* store = nullptr;
+    board* owner = nullptr;
+    size_t slot = 0;
+
+    friend class npc_store;
+    friend class board;
 
 public:
     npc(const string& _name, npc_type _type, int _x, int _y) : name(_name), type(_type), x(_x), y(_y) {}
+    // A copy would share the original's row in the store.
+    npc(const npc&) = delete;
+    npc& operator =(const npc&) = delete;
     virtual ~npc() = default;
     
     virtual int move_distance() const = 0;
@@ -95,27 +138,27 @@ public:
 
     string get_name() const { return name; }
     npc_type get_type() const { return type; }
-    int get_x() const { return x; }
-    int get_y() const { return y; }
-    npc_status get_status() const { return status; }
+    int get_x() const { return store ? store->x[slot] : x; }
+    int get_y() const { return store ? store->y[slot] : y; }
+    npc_status get_status() const { return store ? store->status[slot] : status; }
+    size_t get_slot() const { return slot; }
 
     virtual npc_type get_enemy_type() const = 0;
 
-    void set_status(npc_status effect) { status = effect; }
+    void set_status(npc_status effect) { (store ? store->status[slot] : status) = effect; }
     
-    void move(int _x, int _y) {
-        x = _x;
-        y = _y;
-    }
+    // A piece on a board moves through board::move_piece, which keeps the grid in step.
+    void move(int _x, int _y);
 
     static int sqr_distance(const npc& a, const npc& b) {
-        return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y);
+        int dx = a.get_x() - b.get_x(), dy = a.get_y() - b.get_y();
+        return dx * dx + dy * dy;
     }
 
     friend ostream& operator <<(ostream& os, const npc& piece) {
         os << "Name: " << piece.name << '\n';
         os << "Type: " << piece.type << '\n';
-        os << "Coordinates: (" << piece.x << ", " << piece.y << ")" << '\n';
+        os << "Coordinates: (" << piece.get_x() << ", " << piece.get_y() << ")" << '\n';
         return os;
     }
 };
@@ -156,6 +199,86 @@ public:
     }
 };
 
+void npc_store::add(npc& piece) {
+    piece.slot = size();
+    x.push_back(piece.x);
+    y.push_back(piece.y);
+    type.push_back(piece.type);
+    status.push_back(piece.status);
+    if (free_names.empty()) {
+        name_id.push_back(names.size());
+        names.push_back(piece.name);
+    }
+    else {
+        name_id.push_back(free_names.back());
+        free_names.pop_back();
+        names[name_id.back()] = piece.name;
+    }
+    owners.push_back(&piece);
+    piece.store = this;
+}
+
+void npc_store::release(npc& piece) {
+    piece.x = x[piece.slot];
+    piece.y = y[piece.slot];
+    piece.status = status[piece.slot];
+    piece.store = nullptr;
+    owners[piece.slot] = nullptr;
+    names[name_id[piece.slot]].clear();
+    free_names.push_back(name_id[piece.slot]);
+}
+
+void npc_store::compact() {
+    size_t kept = 0;
+    for (size_t i = 0; i < size(); ++i) {
+        if (!owners[i])
+            continue;
+        x[kept] = x[i];
+        y[kept] = y[i];
+        type[kept] = type[i];
+        status[kept] = status[i];
+        name_id[kept] = name_id[i];
+        owners[kept] = owners[i];
+        owners[kept]->slot = kept;
+        ++kept;
+    }
+    x.resize(kept);
+    y.resize(kept);
+    type.resize(kept);
+    status.resize(kept);
+    name_id.resize(kept);
+    owners.resize(kept);
+}
+
+// The same rules as the npc classes, as functions of the type column.
+constexpr int move_distance_of(npc_type type) {
+    switch (type) {
+        case npc_type::knight: return 30;
+        case npc_type::squirrel: return 5;
+        case npc_type::pegasus: return 30;
+        default: throw invalid_argument("IMPOSSIBLE_TYPE");
+    }
+}
+
+constexpr npc_type enemy_of(npc_type type) {
+    switch (type) {
+        case npc_type::knight: return npc_type::squirrel;
+        case npc_type::squirrel: return npc_type::pegasus;
+        case npc_type::pegasus: return npc_type::knight;
+        default: throw invalid_argument("IMPOSSIBLE_TYPE");
+    }
+}
+
+// Pegasi never attack.
+constexpr int combat_radius_of(npc_type type) {
+    switch (type) {
+        case npc_type::knight: return Knight::attack_radius;
+        case npc_type::squirrel: return Squirrel::attack_radius;
+        case npc_type::pegasus: return 0;
+        default: throw invalid_argument("IMPOSSIBLE_TYPE");
+    }
+}
+
 class npc_factory {
 public:
     static unique_ptr<npc> create_npc(const string& name, npc_type type, int x, int y) {
@@ -168,16 +291,94 @@ public:
     }
 };
 
-class fight_visitor;
+// Uniform hash grid over the board. A cell is as wide as the longest attack radius, so every
+// piece within reach of an aggressor lies in the aggressor's cell or one of its 8 neighbours.
+class spatial_grid {
+public:
+    static constexpr int cell_size = max({Knight::attack_radius, Squirrel::attack_radius, Pegasus::attack_radius});
+
+    void insert(size_t slot, int x, int y) {
+        cells[key(x, y)].push_back(slot);
+    }
+
+    void erase(size_t slot, int x, int y) {
+        auto it = cells.find(key(x, y));
+        if (it == cells.end())
+            return;
+        auto& bucket = it->second;
+        auto found = find(bucket.begin(), bucket.end(), slot);
+        if (found == bucket.end())
+            return;
+        *found = bucket.back();
+        bucket.pop_back();
+        if (bucket.empty())
+            cells.erase(it);
+    }
+
+    static bool same_cell(int x0, int y0, int x1, int y1) {
+        return key(x0, y0) == key(x1, y1);
+    }
+
+    void relocate(size_t slot, int old_x, int old_y, int x, int y) {
+        if (same_cell(old_x, old_y, x, y))
+            return;
+        erase(slot, old_x, old_y);
+        insert(slot, x, y);
+    }
+
+    // Refills the cells from the coordinate columns, once the store has renumbered its rows.
+    void assign(const vector<int>& xs, const vector<int>& ys) {
+        cells.clear();
+        for (size_t i = 0; i < xs.size(); ++i)
+            insert(i, xs[i], ys[i]);
+    }
+
+    template<typename F>
+    void for_each_near(int x, int y, F f) const {
+        int cx = cell(x), cy = cell(y);
+        for (int dx = -1; dx <= 1; ++dx)
+            for (int dy = -1; dy <= 1; ++dy) {
+                auto it = cells.find(key_of_cell(cx + dx, cy + dy));
+                if (it == cells.end())
+                    continue;
+                for (size_t slot: it->second)
+                    f(slot);
+            }
+    }
+
+private:
+    // Store slots by cell.
+    unordered_map<long long, vector<size_t>> cells;
+
+    // Floor division, moves are not clamped to the board so coordinates may be negative.
+    static int cell(int c) {
+        return c >= 0 ? c / cell_size : (c - cell_size + 1) / cell_size;
+    }
+
+    static long long key_of_cell(int cx, int cy) {
+        return static_cast<long long>(cx) << 32 | static_cast<unsigned>(cy);
+    }
+
+    static long long key(int x, int y) {
+        return key_of_cell(cell(x), cell(y));
+    }
+};
 
 class board: public subject {
     int n, m;
     vector<unique_ptr<npc>> pieces;
+    npc_store store;
     set<string> captured;
     list<observer*> observers;
+    spatial_grid grid;
 
 public:
     board(int _n, int _m) : n(_n), m(_m) {}
+    // Pieces point back at their board and its store.
+    board(const board&) = delete;
+    board& operator =(const board&) = delete;
+    board(board&&) = delete;
+    board& operator =(board&&) = delete;
     
     void cycle();
     
@@ -192,6 +393,9 @@ public:
             piece->get_x() < 0 || piece->get_y() < 0 ||
             captured.find(piece->get_name()) != captured.end())
             throw invalid_argument("IMPOSSIBLE_PIECE");
+        store.add(*piece);
+        piece->owner = this;
+        grid.insert(piece->slot, piece->get_x(), piece->get_y());
         pieces.push_back(move(piece));
     }
     
@@ -202,19 +406,126 @@ public:
             if (piece->get_name() == npc_name && piece->get_status() == npc_status::alive) {
                 if (captured.find(npc_name) != captured.end())
                     throw invalid_argument("DEAD_MOVEMENT");
-                ostringstream message;
-                message << piece->get_name() << " moves from (" << piece->get_x() << ", " << piece->get_y()
-                        << ") to (" << new_x << ", " << new_y << ").\n";
-                piece->move(new_x, new_y);
-                notify(message.str());
+                move_piece(*piece, new_x, new_y);
                 return;
             }
         }
         throw invalid_argument("NAME_ERROR");
     }
 
-    auto& get_pieces() { return pieces; }
-    
+    // Moves a piece already held by the caller, without looking it up by name.
+    void move_piece(npc& piece, int new_x, int new_y) {
+        if (piece.owner != this)
+            throw invalid_argument("IMPOSSIBLE_PIECE");
+        size_t slot = piece.slot;
+        int old_x = store.x[slot], old_y = store.y[slot];
+        ostringstream message;
+        message << store.name_of(slot) << " moves from (" << old_x << ", " << old_y
+                << ") to (" << new_x << ", " << new_y << ").\n";
+        store.x[slot] = new_x;
+        store.y[slot] = new_y;
+        grid.relocate(slot, old_x, old_y, new_x, new_y);
+        notify(message.str());
+    }
+
+    // Movement system: shifts every living piece by (dx[i], dy[i]), clamped to the board.
+    // run(count, grain, f) calls f(begin, end) on the chunks of grain rows, possibly in parallel.
+    // A chunk only writes its own rows and keeps its grid moves and log lines to itself, they are
+    // merged in row order once all chunks are done.
+    template <typename Runner>
+    void move_all(const vector<int>& dx, const vector<int>& dy, size_t grain, Runner run) {
+        size_t count = store.size();
+        if (dx.size() != count || dy.size() != count)
+            throw invalid_argument("IMPOSSIBLE_MOVEMENT");
+        struct relocation {
+            size_t slot;
+            int old_x, old_y;
+        };
+        struct moved_chunk {
+            vector<relocation> relocations;
+            string message;
+        };
+        grain = max<size_t>(grain, 1);
+        vector<moved_chunk> chunks((count + grain - 1) / grain);
+        int max_x = n - 1, max_y = m - 1;
+
+        run(count, grain, [&](size_t begin, size_t end) {
+            int* xs = store.x.data();
+            int* ys = store.y.data();
+            const int* step_x = dx.data();
+            const int* step_y = dy.data();
+            const npc_status* status = store.status.data();
+            vector<int> old_x(xs + begin, xs + end), old_y(ys + begin, ys + end);
+            for (size_t i = begin; i < end; ++i) {
+                int alive = status[i] == npc_status::alive;
+                int moved_x = min(max(xs[i] + step_x[i], 0), max_x);
+                int moved_y = min(max(ys[i] + step_y[i], 0), max_y);
+                xs[i] += alive * (moved_x - xs[i]);
+                ys[i] += alive * (moved_y - ys[i]);
+            }
+            moved_chunk& chunk = chunks[begin / grain];
+            ostringstream message;
+            for (size_t i = begin; i < end; ++i) {
+                if (status[i] != npc_status::alive)
+                    continue;
+                int from_x = old_x[i - begin], from_y = old_y[i - begin];
+                if (!spatial_grid::same_cell(from_x, from_y, xs[i], ys[i]))
+                    chunk.relocations.push_back({i, from_x, from_y});
+                message << store.name_of(i) << " moves from (" << from_x << ", " << from_y
+                        << ") to (" << xs[i] << ", " << ys[i] << ").\n";
+            }
+            chunk.message = message.str();
+        });
+
+        string message;
+        for (const moved_chunk& chunk: chunks) {
+            for (const relocation& r: chunk.relocations)
+                grid.relocate(r.slot, r.old_x, r.old_y, store.x[r.slot], store.y[r.slot]);
+            message += chunk.message;
+        }
+        notify(message);
+    }
+
+    void move_all(const vector<int>& dx, const vector<int>& dy) {
+        move_all(dx, dy, dx.size(), [](size_t count, size_t grain, auto f) {
+            for (size_t begin = 0; begin < count; begin += grain)
+                f(begin, min(count, begin + grain));
+        });
+    }
+
+    // Compacting the store renumbers the rows, so the grid is refilled when anything was removed.
+    template <typename P>
+    void remove_npcs(P predicate) {
+        size_t count = pieces.size();
+        pieces.erase(remove_if(pieces.begin(), pieces.end(), [&](const unique_ptr<npc>& piece) {
+            if (!predicate(*piece))
+                return false;
+            store.release(*piece);
+            piece->owner = nullptr;
+            return true;
+        }), pieces.end());
+        if (pieces.size() == count)
+            return;
+        store.compact();
+        grid.assign(store.x, store.y);
+    }
+
+    int get_width() const { return n; }
+    int get_height() const { return m; }
+
+    size_t get_count() const { return pieces.size(); }
+
+    // Pieces are kept in store order, so index is also the piece's slot.
+    const npc& get_piece(size_t index) const {
+        if (index >= pieces.size())
+            throw invalid_argument("INVALID_INDEX");
+        return *pieces[index];
+    }
+
+    const spatial_grid& get_grid() const { return grid; }
+
+    const npc_store& get_store() const { return store; }
+
         void attach(observer* o) override {
         observers.push_back(o);
     }
@@ -229,98 +540,237 @@ public:
     }
 };
 
-class fight_visitor : public npc_visitor {
-    board& game;
-    vector<string> to_remove;
+// Combat system: each piece that is not dead attacks the living enemies within its radius.
+// An attack kills when its roll beats the defender's.
+void board::cycle() {
+    mt19937 rng;
+    uniform_int_distribution<> dice(1, 6);
+    const int* xs = store.x.data();
+    const int* ys = store.y.data();
+    const npc_type* types = store.type.data();
+    npc_status* status = store.status.data();
+
+    for (size_t i = 0; i < store.size(); ++i) {
+        int radius = combat_radius_of(types[i]);
+        if (status[i] == npc_status::dead || radius == 0)
+            continue;
+        npc_type enemy = enemy_of(types[i]);
+        grid.for_each_near(xs[i], ys[i], [&](size_t j) {
+            int dx = xs[i] - xs[j], dy = ys[i] - ys[j];
+            if (status[j] != npc_status::alive || types[j] != enemy || dx * dx + dy * dy > radius * radius)
+                return;
+            int attack_roll = dice(rng);
+            int defense_roll = dice(rng);
+            if (defense_roll < attack_roll)
+                status[j] = npc_status::beaten;
+        });
+    }
+    
+    ostringstream message;
+    
+    for (size_t i = 0; i < store.size(); ++i) {
+        if (status[i] == npc_status::beaten) {
+            message << store.name_of(i) << " has been killed.\n";
+            status[i] = npc_status::dead;
+        }
+    }
+    
+    remove_npcs([](const npc& piece) { return piece.get_status() == npc_status::dead; });
+    
+    message << "\nAfter the battle:\n";
+    for (const auto& piece : pieces)
+        message << *piece << '\n';
+        
+    notify(message.str());
+}
 
-public:
-    fight_visitor(board& b) : game(b) {}
+void npc::move(int _x, int _y) {
+    if (owner) {
+        owner->move_piece(*this, _x, _y);
+        return;
+    }
+    x = _x;
+    y = _y;
+}
 
-    void visit(Knight& knight) override {
-        engage_in_battle(knight, Knight::attack_radius);
+// Fixed set of threads, each with its own task deque. A worker takes from the back of its own
+// deque and, when that is empty, steals from the front of the others.
+class worker_pool {
+    struct worker_queue {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+
+    vector<worker_queue> queues;
+    vector<thread> workers;
+    mutex state_lock;
+    condition_variable wake, idle;
+    size_t queued = 0, pending = 0, next_queue = 0;
+    bool stopping = false;
+
+    bool try_pop(size_t index, function<void()>& task) {
+        for (size_t i = 0; i < queues.size(); ++i) {
+            auto& queue = queues[(index + i) % queues.size()];
+            lock_guard<mutex> lock(queue.lock);
+            if (queue.tasks.empty())
+                continue;
+            if (i == 0) {
+                task = move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            else {
+                task = move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            lock_guard<mutex> state(state_lock);
+            --queued;
+            return true;
+        }
+        return false;
     }
 
-    void visit(Squirrel& squirrel) override {
-        engage_in_battle(squirrel, Squirrel::attack_radius);
+    void run(size_t index) {
+        function<void()> task;
+        while (true) {
+            if (try_pop(index, task)) {
+                task();
+                lock_guard<mutex> lock(state_lock);
+                if (--pending == 0)
+                    idle.notify_all();
+                continue;
+            }
+            unique_lock<mutex> lock(state_lock);
+            wake.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping && queued == 0)
+                return;
+        }
     }
 
-    void visit(Pegasus& pegasus) override {}
+public:
+    explicit worker_pool(unsigned thread_count) : queues(max(thread_count, 1u)) {
+        for (size_t i = 0; i < queues.size(); ++i)
+            workers.emplace_back([this, i] { run(i); });
+    }
 
-    void remove_defeated() {
-        for (auto& name : to_remove) {
-            auto& pieces = game.get_pieces();
-            pieces.erase(remove_if(pieces.begin(), pieces.end(), [&name](const unique_ptr<npc>& piece) {
-                return piece->get_name() == name;
-            }), pieces.end());
+    ~worker_pool() {
+        {
+            lock_guard<mutex> lock(state_lock);
+            stopping = true;
         }
+        wake.notify_all();
+        for (auto& t : workers)
+            t.join();
     }
 
-private:
-    mt19937 rng;
+    size_t size() const { return workers.size(); }
 
-    int roll_dice() {
-        uniform_int_distribution<> dice(1, 6);
-        return dice(rng);
+    // The counters go up before the task is visible, so a worker never takes it first.
+    void submit(function<void()> task) {
+        size_t index;
+        {
+            lock_guard<mutex> lock(state_lock);
+            index = next_queue++ % queues.size();
+            ++queued;
+            ++pending;
+        }
+        {
+            lock_guard<mutex> lock(queues[index].lock);
+            queues[index].tasks.push_back(move(task));
+        }
+        wake.notify_one();
     }
 
-    template <typename T>
-    void engage_in_battle(T& aggressor, int radius) {
-        for (auto& piece : game.get_pieces()) {
-            if (piece->get_status() == npc_status::alive &&
-                aggressor.get_enemy_type() == piece->get_type() &&
-                npc::sqr_distance(aggressor, *piece) <= radius * radius) {
-
-                int attack_roll = roll_dice();
-                int defense_roll = roll_dice();
+    void wait() {
+        unique_lock<mutex> lock(state_lock);
+        idle.wait(lock, [this] { return pending == 0; });
+    }
 
-                if(defense_roll >= attack_roll)
-                    continue;
-                
-                piece->set_status(npc_status::beaten);    
-                to_remove.push_back(piece->get_name());
-            }
+    // Runs f(begin, end) over [0, count) in chunks of grain and waits for all of them.
+    template <typename F>
+    void parallel_chunks(size_t count, size_t grain, F f) {
+        grain = max<size_t>(grain, 1);
+        for (size_t begin = 0; begin < count; begin += grain) {
+            size_t end = min(count, begin + grain);
+            submit([begin, end, &f] { f(begin, end); });
         }
+        wait();
+    }
+
+    template <typename F>
+    void parallel_for(size_t count, size_t grain, F f) {
+        parallel_chunks(count, grain, [&f](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                f(i);
+        });
     }
 };
 
-void board::cycle() {
-    fight_visitor visitor(*this);
-    
-    for (auto& piece : pieces)
-        if (piece->get_status() != npc_status::dead)
-            piece->accept(visitor);
-    
-    ostringstream message;
-    
-    for (auto it = pieces.begin(); it != pieces.end(); ++it) {
-        auto& piece = *it;
-        if (piece->get_status() == npc_status::beaten) {
-            message << piece->get_name() << " has been killed.\n";
-            piece->set_status(npc_status::dead);
+// thread_count workers pick and apply the steps in chunks of grain rows. Combat is resolved on
+// the calling thread: its rolls come from one engine, in board order.
+struct simulation_config {
+    int tick_rate = 10;
+    unsigned thread_count = max(thread::hardware_concurrency(), 1u);
+    chrono::seconds duration{30};
+    unsigned seed = random_device{}();
+    size_t grain = 256;
+};
+
+// Advances the board in discrete ticks: every piece picks a step and the movement system
+// applies them, both in parallel over chunks of rows, then one battle cycle resolves the tick.
+class simulation {
+    board& game;
+    simulation_config config;
+    worker_pool pool;
+    unsigned long long ticks = 0;
+
+public:
+    simulation(board& b, const simulation_config& c) : game(b), config(c), pool(c.thread_count) {
+        if (config.tick_rate <= 0)
+            throw invalid_argument("IMPOSSIBLE_TICK_RATE");
+    }
+
+    void tick() {
+        const npc_store& store = game.get_store();
+        vector<int> dx(store.size()), dy(store.size());
+        pool.parallel_chunks(store.size(), config.grain, [&](size_t begin, size_t end) {
+            seed_seq seed{config.seed, static_cast<unsigned>(ticks), static_cast<unsigned>(begin)};
+            mt19937 gen(seed);
+            for (size_t i = begin; i < end; ++i) {
+                int reach = move_distance_of(store.type[i]);
+                uniform_int_distribution<> step(-reach, reach);
+                dx[i] = step(gen);
+                dy[i] = step(gen);
+            }
+        });
+        game.move_all(dx, dy, config.grain, [this](size_t count, size_t grain, auto f) {
+            pool.parallel_chunks(count, grain, f);
+        });
+        game.cycle();
+        ++ticks;
+    }
+
+    void run() {
+        auto period = chrono::duration_cast<chrono::steady_clock::duration>(chrono::seconds(1)) / config.tick_rate;
+        auto finish = chrono::steady_clock::now() + config.duration;
+        for (auto next = chrono::steady_clock::now(); next < finish; next += period) {
+            tick();
+            this_thread::sleep_until(next + period);
         }
     }
-    
-    visitor.remove_defeated();
-    
-    message << "\nAfter the battle:\n";
-    for (const auto& piece : pieces)
-        message << *piece << '\n';
-        
-    notify(message.str());
-}
+
+    unsigned long long get_ticks() const { return ticks; }
+};
 
 int main() {
     const int NPC_COUNT = 50;
     const int BOARD_WIDTH = 100;
     const int BOARD_HEIGHT = 100;
     const int GAME_DURATION = 30;
+    const int TICK_RATE = 10;
 
     board game(BOARD_WIDTH, BOARD_HEIGHT);
     terminal_observer terminal_record;
     file_observer file_record("log.txt");
-    mutex cout_mutex;
-    vector<thread> threads;
-    atomic<bool> game_active(true);
     
     random_device rd;
     mt19937 gen(rd());
@@ -338,36 +788,11 @@ int main() {
     game.attach(&terminal_record);
     game.attach(&file_record);
 
-    for (auto& piece : game.get_pieces()) {
-        threads.emplace_back([&game, &piece, &gen, &dis, &cout_mutex, &game_active]() {
-            while (game_active) {
-                lock_guard<mutex> lock(cout_mutex);
-                if(dis(gen) % 4 == 0)
-                    game.move_npc(piece->get_name(), dis(gen) % piece->move_distance() + 1, dis(gen) % piece->move_distance() + 1);
-                else if(dis(gen) % 4 == 1)
-                    game.move_npc(piece->get_name(), dis(gen) % piece->move_distance() + 1, -dis(gen) % piece->move_distance() - 1);
-                else if(dis(gen) % 4 == 2)
-                    game.move_npc(piece->get_name(), -dis(gen) % piece->move_distance() - 1, dis(gen) % piece->move_distance() + 1);
-                else
-                    game.move_npc(piece->get_name(), -dis(gen) % piece->move_distance() - 1, -dis(gen) % piece->move_distance() + 1);
-                game.cycle();
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            }
-        });
-    }
-
-    thread timer_thread([&game_active, GAME_DURATION]() {
-        this_thread::sleep_for(chrono::seconds(GAME_DURATION));
-        game_active = false; 
-    });
-
-    timer_thread.join();
-
-    for (auto& t : threads) 
-        if (t.joinable()) 
-            t.join();
-
-    { lock_guard<mutex> guard(cout_mutex); }
+    simulation_config config;
+    config.tick_rate = TICK_RATE;
+    config.duration = chrono::seconds(GAME_DURATION);
+    config.seed = rd();
+    simulation(game, config).run();
 
     game.detach(&terminal_record);
     game.detach(&file_record);